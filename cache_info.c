@@ -3,15 +3,25 @@
  * Detects cache sizes and cache line sizes using timing-based probing
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #ifdef __APPLE__
 #include <mach/mach_time.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
 /* High-resolution timing */
 #if defined(__x86_64__) || defined(__i386__)
 static inline uint64_t get_time(void) {
@@ -98,35 +108,18 @@ int probe_cache_line_size(void) {
     return detected;
 }
 
-/* Create pointer-chase pattern */
+/* Sattolo's shuffle: one random cycle through every element */
 static void create_pointer_chase(size_t *array, size_t count) {
     for (size_t i = 0; i < count; i++) {
-        array[i] = (i + 1) % count;
+        array[i] = i;
     }
 
     for (size_t i = count - 1; i > 0; i--) {
-        size_t j = (size_t)rand() % (i + 1);
+        size_t j = (size_t)rand() % i;
         size_t temp = array[i];
         array[i] = array[j];
         array[j] = temp;
     }
-
-    size_t *visited = (size_t *)calloc(count, sizeof(size_t));
-    size_t *chase = (size_t *)malloc(count * sizeof(size_t));
-
-    size_t pos = 0;
-    for (size_t i = 0; i < count; i++) {
-        chase[pos] = array[i];
-        visited[pos] = 1;
-        pos = array[i];
-    }
-
-    for (size_t i = 0; i < count; i++) {
-        array[i] = chase[i];
-    }
-
-    free(visited);
-    free(chase);
 }
 
 /* Detect cache sizes via pointer-chase */
@@ -259,7 +252,821 @@ int probe_associativity(void) {
     return detected;
 }
 
-int main(void) {
+/* Wall-clock seconds, for throughput */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Sum every stride-th element; four accumulators keep the adds off the critical path */
+static size_t mountain_read(const size_t *data, size_t elems, size_t stride) {
+    size_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 3 * stride < elems; i += 4 * stride) {
+        s0 += data[i];
+        s1 += data[i + stride];
+        s2 += data[i + 2 * stride];
+        s3 += data[i + 3 * stride];
+    }
+    for (; i < elems; i += stride) s0 += data[i];
+    return s0 + s1 + s2 + s3;
+}
+
+#define MOUNTAIN_STRIDES 14
+
+/*
+ * Memory mountain: read throughput over working-set size x stride.
+ * Sizes double from 4KB up to 4GB or a quarter of physical memory,
+ * strides run 1..64 elements of 8 bytes. Each cell is the best of
+ * several passes over a warm working set, in MB/s of data actually read.
+ */
+int probe_memory_mountain(const char *path) {
+    const int ITERATIONS = 3;
+    const size_t MIN_READS = 4 * 1024 * 1024;
+    const size_t strides[MOUNTAIN_STRIDES] = {1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 24, 32, 48, 64};
+
+    size_t max_size = (size_t)4 * 1024 * 1024 * 1024;
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0 && (size_t)pages * page_size / 4 < max_size)
+        max_size = (size_t)pages * page_size / 4;
+
+    size_t *data = (size_t *)malloc(max_size);
+    while (!data && max_size > 64 * 1024 * 1024) {
+        max_size /= 2;
+        data = (size_t *)malloc(max_size);
+    }
+    if (!data) return -1;
+    for (size_t i = 0; i < max_size / sizeof(size_t); i++) data[i] = i;
+
+    FILE *out = stdout;
+    if (path && !(out = fopen(path, "w"))) {
+        perror(path);
+        free(data);
+        return -1;
+    }
+
+    fprintf(out, "# memory mountain: read throughput in MB/s\n");
+    fprintf(out, "# size_bytes");
+    for (int s = 0; s < MOUNTAIN_STRIDES; s++) fprintf(out, "\ts%zu", strides[s]);
+    fprintf(out, "\n");
+
+    volatile size_t sink = 0;
+    for (size_t size = 4 * 1024; size <= max_size; size *= 2) {
+        size_t elems = size / sizeof(size_t);
+        fprintf(out, "%zu", size);
+
+        for (int s = 0; s < MOUNTAIN_STRIDES; s++) {
+            size_t stride = strides[s];
+            size_t reads = (elems + stride - 1) / stride;
+            size_t reps = MIN_READS / reads + 1;
+            double best = 0.0;
+
+            sink += mountain_read(data, elems, stride);
+            for (int iter = 0; iter < ITERATIONS; iter++) {
+                double start = now_sec();
+                for (size_t r = 0; r < reps; r++)
+                    sink += mountain_read(data, elems, stride);
+                double secs = now_sec() - start;
+                double mbps = (double)reads * reps * sizeof(size_t) / secs / 1e6;
+                if (mbps > best) best = mbps;
+            }
+            fprintf(out, "\t%.0f", best);
+        }
+        fprintf(out, "\n");
+        fflush(out);
+    }
+
+    if (out != stdout) fclose(out);
+    free(data);
+    return 0;
+}
+
+#define MAX_CPUS 1024
+
+/* CPUs this process may run on, ascending. Returns the count. */
+static int allowed_cpus(int *cpus, int max) {
+    int n = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++)
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        return n;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int c = 0; c < online && n < max; c++) cpus[n++] = c;
+    return n;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success. */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+static void sleep_sec(double secs) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)secs;
+    ts.tv_nsec = (long)((secs - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+/* 2MB-aligned buffer, THP-backed where the kernel allows it */
+static size_t *alloc_buffer(size_t bytes) {
+    const size_t HUGE = 2 * 1024 * 1024;
+    size_t rounded = (bytes + HUGE - 1) / HUGE * HUGE;
+    size_t *p = (size_t *)aligned_alloc(HUGE, rounded);
+#ifdef MADV_HUGEPAGE
+    if (p) madvise(p, rounded, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+/* Largest cache the OS reports, for sizing DRAM working sets */
+static size_t last_level_cache_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 32 * 1024 * 1024;
+}
+
+static size_t physical_memory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (size_t)pages * page_size;
+    return (size_t)4 * 1024 * 1024 * 1024;
+}
+
+#define MAX_NODES 1024
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+/*
+ * Bind not-yet-touched memory to one NUMA node with the raw mbind
+ * syscall, so no libnuma is needed. Returns 0 on success.
+ */
+static int bind_to_node(void *p, size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return (int)syscall(SYS_mbind, p, bytes, MPOL_BIND, mask,
+                        (unsigned long)MAX_NODES + 1, MPOL_MF_MOVE);
+#else
+    (void)p;
+    (void)bytes;
+    (void)node;
+    return -1;
+#endif
+}
+
+enum bw_kind { BW_READ, BW_WRITE, BW_RMW };
+enum bw_state { BW_IDLE, BW_PREPARE, BW_RUN, BW_QUIT };
+
+static const char *bw_kind_names[] = { "read", "write", "rmw" };
+
+#define BW_CHUNK 4096               /* bytes between delay and progress updates */
+
+/*
+ * A pinned bandwidth thread. PREPARE (re)allocates and touches `bytes`
+ * of its own memory, on its CPU's node or bound to `node` if set; RUN
+ * sweeps it in BW_CHUNK pieces with `delay` spin iterations after each,
+ * counting bytes read plus written.
+ */
+struct bw_worker {
+    pthread_t thread;
+    int cpu;
+    int kind;
+    /* Requested by the controller; latched by the worker on PREPARE only */
+    size_t req_bytes;
+    int req_delay;
+    int req_node;                   /* NUMA node for the buffer, -1 for local */
+    /* Worker-owned copies used while running */
+    size_t bytes;
+    int delay;
+    int node;
+    volatile int state;
+    volatile int ready;
+    volatile uint64_t moved;
+    volatile size_t sink;
+    size_t *buf;
+    size_t capacity;
+    int buf_node;
+} __attribute__((aligned(128)));
+
+static size_t bw_kernel(int kind, size_t *p, size_t elems) {
+    switch (kind) {
+    case BW_WRITE:
+        for (size_t i = 0; i < elems; i++) p[i] = i;
+        return 0;
+    case BW_RMW:
+        for (size_t i = 0; i < elems; i++) p[i] += 1;
+        return 0;
+    default: {
+        size_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (size_t i = 0; i + 3 < elems; i += 4) {
+            s0 += p[i];
+            s1 += p[i + 1];
+            s2 += p[i + 2];
+            s3 += p[i + 3];
+        }
+        return s0 + s1 + s2 + s3;
+    }
+    }
+}
+
+static void *bw_thread(void *arg) {
+    struct bw_worker *w = (struct bw_worker *)arg;
+    pin_to_cpu(w->cpu);
+    size_t chunk = BW_CHUNK / sizeof(size_t);
+    uint64_t per_chunk = w->kind == BW_RMW ? 2 * BW_CHUNK : BW_CHUNK;
+
+    for (;;) {
+        int state = __atomic_load_n(&w->state, __ATOMIC_ACQUIRE);
+        if (state == BW_QUIT) break;
+        if (state == BW_IDLE) {
+            sleep_sec(50e-6);
+            continue;
+        }
+        if (state == BW_PREPARE) {
+            if (!w->ready) {
+                w->bytes = w->req_bytes;
+                w->delay = w->req_delay;
+                w->node = w->req_node;
+                if (w->bytes > w->capacity || w->bytes < w->capacity / 2 ||
+                    w->node != w->buf_node) {
+                    free(w->buf);
+                    w->buf = alloc_buffer(w->bytes);
+                    w->capacity = w->buf ? w->bytes : 0;
+                    w->buf_node = w->node;
+                    if (w->buf && w->node >= 0) bind_to_node(w->buf, w->bytes, w->node);
+                    if (w->buf) memset(w->buf, 1, w->bytes);
+                }
+                __atomic_store_n(&w->ready, 1, __ATOMIC_RELEASE);
+            }
+            continue;
+        }
+
+        size_t elems = w->capacity ? w->bytes / sizeof(size_t) : 0;
+        size_t sink = 0;
+        for (size_t off = 0; off + chunk <= elems; off += chunk) {
+            sink += bw_kernel(w->kind, w->buf + off, chunk);
+            for (int d = 0; d < w->delay; d++) __asm__ __volatile__ ("");
+            __atomic_store_n(&w->moved, w->moved + per_chunk, __ATOMIC_RELAXED);
+            if (__atomic_load_n(&w->state, __ATOMIC_RELAXED) != BW_RUN) break;
+        }
+        w->sink = sink;
+        if (elems < chunk) sleep_sec(50e-6);
+    }
+    free(w->buf);
+    return NULL;
+}
+
+static void stop_bw_workers(struct bw_worker *w, int n) {
+    for (int i = 0; i < n; i++) __atomic_store_n(&w[i].state, BW_QUIT, __ATOMIC_RELEASE);
+    for (int i = 0; i < n; i++) pthread_join(w[i].thread, NULL);
+    free(w);
+}
+
+/* Idle workers on `cpus`, or NULL if any of them could not be started */
+static struct bw_worker *start_bw_workers(const int *cpus, int n, int kind) {
+    struct bw_worker *w = (struct bw_worker *)aligned_alloc(128, n * sizeof(*w));
+    if (!w) return NULL;
+    memset(w, 0, n * sizeof(*w));
+    for (int i = 0; i < n; i++) {
+        w[i].cpu = cpus[i];
+        w[i].kind = kind;
+        w[i].req_node = w[i].node = w[i].buf_node = -1;
+        if (pthread_create(&w[i].thread, NULL, bw_thread, &w[i]) != 0) {
+            stop_bw_workers(w, i);
+            return NULL;
+        }
+    }
+    return w;
+}
+
+/*
+ * Set the first `active` workers running over `bytes` each; idle the rest.
+ * Running workers keep their own copies of the parameters, so new ones
+ * only take effect once each worker has passed through PREPARE.
+ */
+static void run_bw_workers(struct bw_worker *w, int n, int active, size_t bytes, int delay) {
+    for (int i = 0; i < n; i++) {
+        if (i >= active) {
+            __atomic_store_n(&w[i].state, BW_IDLE, __ATOMIC_RELEASE);
+            continue;
+        }
+        w[i].req_bytes = bytes;
+        w[i].req_delay = delay;
+        w[i].ready = 0;
+        __atomic_store_n(&w[i].state, BW_PREPARE, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < active; i++)
+        while (!__atomic_load_n(&w[i].ready, __ATOMIC_ACQUIRE)) sleep_sec(100e-6);
+    for (int i = 0; i < active; i++)
+        __atomic_store_n(&w[i].state, BW_RUN, __ATOMIC_RELEASE);
+}
+
+static uint64_t bw_moved(const struct bw_worker *w, int n) {
+    uint64_t total = 0;
+    for (int i = 0; i < n; i++) total += __atomic_load_n(&w[i].moved, __ATOMIC_RELAXED);
+    return total;
+}
+
+#define LOADED_DELAYS 11
+
+/*
+ * Loaded latency: a DRAM-sized pointer chase on the first allowed CPU
+ * while 1, 2, 4, ... and all other CPUs generate `kind` traffic, each
+ * throttled by a spin delay after every 4KB. Each point pairs the chase's
+ * average latency with the bandwidth the generators delivered during it.
+ */
+int probe_loaded_latency(int kind, const char *path) {
+    const size_t ACCESSES = 1 << 20;
+    const int delays[LOADED_DELAYS] = {0, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000};
+
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    if (n < 1) return -1;
+    int gens = n - 1;
+    if (pin_to_cpu(cpus[0]) != 0 && gens > 0)
+        printf("Could not pin threads; results include scheduler noise.\n");
+
+    size_t llc = last_level_cache_size(), phys = physical_memory();
+    size_t chase_bytes = 4 * llc < 256 * 1024 * 1024 ? 256 * 1024 * 1024 : 4 * llc;
+    if (chase_bytes > (size_t)1024 * 1024 * 1024) chase_bytes = (size_t)1024 * 1024 * 1024;
+    if (chase_bytes > phys / 16) chase_bytes = phys / 16;
+    size_t count = chase_bytes / sizeof(size_t);
+
+    size_t *chase = alloc_buffer(chase_bytes);
+    if (!chase) return -1;
+    srand(12345);
+    create_pointer_chase(chase, count);
+
+    /* Generators share the LLC, so together they cover twice its size */
+    size_t gen_bytes = 16 * 1024 * 1024;
+    if (gens > 0 && 2 * llc / gens > gen_bytes) gen_bytes = 2 * llc / gens;
+    if (gens > 0 && gen_bytes * gens > phys / 4) gen_bytes = phys / 4 / gens;
+
+    struct bw_worker *w = gens > 0 ? start_bw_workers(cpus + 1, gens, kind) : NULL;
+    if (gens > 0 && !w) {
+        free(chase);
+        return -1;
+    }
+
+    FILE *out = stdout;
+    if (path && !(out = fopen(path, "w"))) {
+        perror(path);
+        if (w) stop_bw_workers(w, gens);
+        free(chase);
+        return -1;
+    }
+
+    fprintf(out, "# loaded latency: %zu MB chase on cpu %d, %s traffic\n",
+            chase_bytes >> 20, cpus[0], bw_kind_names[kind]);
+    fprintf(out, "# threads\tdelay\tGB/s\tlatency_ns\n");
+
+    size_t idx = 0;
+    for (int active = 0; active <= gens; active = active ? 2 * active : 1) {
+        if (active > gens / 2 && active < gens) active = gens;
+
+        for (int d = 0; d < LOADED_DELAYS; d++) {
+            if (active > 0) {
+                run_bw_workers(w, gens, active, gen_bytes, delays[d]);
+                sleep_sec(0.02);
+            }
+
+            uint64_t moved0 = w ? bw_moved(w, gens) : 0;
+            double start = now_sec();
+            for (size_t a = 0; a < ACCESSES; a++) idx = chase[idx];
+            double secs = now_sec() - start;
+            uint64_t moved1 = w ? bw_moved(w, gens) : 0;
+
+            fprintf(out, "%d\t%d\t%.2f\t%.1f\n", active, active ? delays[d] : 0,
+                    (double)(moved1 - moved0) / secs / 1e9, secs / ACCESSES * 1e9);
+            fflush(out);
+            if (active == 0) break;
+        }
+        if (w) run_bw_workers(w, gens, 0, 0, 0);
+        if (active == gens) break;
+    }
+    volatile size_t dummy = idx;
+    (void)dummy;
+
+    if (out != stdout) fclose(out);
+    if (w) stop_bw_workers(w, gens);
+    free(chase);
+    return 0;
+}
+
+/* Read one line of a sysfs file. Returns 0 on success. */
+static int read_sys_string(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* Parse a kernel CPU list such as "0-3,8,10-11". Returns the count. */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+/* Where a CPU sits: package, physical core, and index among its SMT siblings */
+struct cpu_place {
+    int cpu;
+    int package;
+    int core;
+    int thread;
+};
+
+static void read_cpu_place(int cpu, struct cpu_place *p) {
+    char path[128], buf[4096];
+    p->cpu = cpu;
+    p->package = p->core = p->thread = 0;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) p->package = atoi(buf);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) p->core = atoi(buf);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) {
+        int siblings[MAX_CPUS];
+        int ns = parse_cpu_list(buf, siblings, MAX_CPUS);
+        for (int i = 0; i < ns; i++)
+            if (siblings[i] == cpu) p->thread = i;
+    }
+}
+
+enum placement { PLACE_COMPACT, PLACE_SCATTER, PLACE_SMT, NUM_PLACEMENTS };
+
+static const char *placement_names[NUM_PLACEMENTS] = { "compact", "scatter", "smt" };
+
+/*
+ * Sort keys, most significant first:
+ *   compact  package, thread, core  - one thread per core, filling a package
+ *   scatter  thread, core, package  - alternate packages, one per core
+ *   smt      package, core, thread  - both siblings of a core before the next
+ */
+static int place_key(const struct cpu_place *p, int policy, int k) {
+    static const int keys[NUM_PLACEMENTS][3] = { {0, 2, 1}, {2, 1, 0}, {0, 1, 2} };
+    int field = keys[policy][k];
+    return field == 0 ? p->package : field == 1 ? p->core : p->thread;
+}
+
+static int sort_policy;
+
+static int compare_place(const void *a, const void *b) {
+    const struct cpu_place *x = (const struct cpu_place *)a, *y = (const struct cpu_place *)b;
+    for (int k = 0; k < 3; k++) {
+        int d = place_key(x, sort_policy, k) - place_key(y, sort_policy, k);
+        if (d) return d;
+    }
+    return x->cpu - y->cpu;
+}
+
+static void order_cpus(const int *cpus, int n, int policy, int *order) {
+    struct cpu_place *places = (struct cpu_place *)malloc(n * sizeof(*places));
+    if (!places) {
+        memcpy(order, cpus, n * sizeof(int));
+        return;
+    }
+    for (int i = 0; i < n; i++) read_cpu_place(cpus[i], &places[i]);
+    sort_policy = policy;
+    qsort(places, n, sizeof(*places), compare_place);
+    for (int i = 0; i < n; i++) order[i] = places[i].cpu;
+    free(places);
+}
+
+#define SCALING_LEVELS 4
+#define SCALING_MAX_COUNTS 32
+
+/*
+ * Bandwidth scaling: `kind` traffic on 1..N threads for each placement
+ * policy, at a working set per cache level. L1 and L2 are private, so
+ * each thread gets half of one; L3 is shared, so half of it is split
+ * across the threads; DRAM uses 4x L3 (at least 256MB) split the same way.
+ * Thread counts grow by about 1.5x so large hosts stay quick.
+ */
+int probe_bandwidth_scaling(int kind, const char *path) {
+    const char *level_names[SCALING_LEVELS] = { "L1", "L2", "L3", "DRAM" };
+
+    int cpus[MAX_CPUS], order[MAX_CPUS], prev[NUM_PLACEMENTS][MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    if (n < 1) return -1;
+
+    size_t l1, l2, l3;
+    probe_cache_sizes(&l1, &l2, &l3);
+    if (l1 == 0) l1 = 32 * 1024;
+    if (l2 == 0) l2 = 1024 * 1024;
+    if (l3 == 0) l3 = last_level_cache_size();
+    size_t dram = 4 * l3 < 256 * 1024 * 1024 ? 256 * 1024 * 1024 : 4 * l3;
+    if (dram > physical_memory() / 4) dram = physical_memory() / 4;
+
+    int counts[SCALING_MAX_COUNTS], num_counts = 0;
+    for (int t = 1; num_counts < SCALING_MAX_COUNTS - 1; t = t < 4 ? t + 1 : t * 3 / 2) {
+        if (t >= n) break;
+        counts[num_counts++] = t;
+    }
+    counts[num_counts++] = n;
+
+    FILE *out = stdout;
+    if (path && !(out = fopen(path, "w"))) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(out, "# bandwidth scaling: %s GB/s, L1 %zuKB L2 %zuKB L3 %zuKB DRAM %zuMB\n",
+            bw_kind_names[kind], l1 >> 10, l2 >> 10, l3 >> 10, dram >> 20);
+    fprintf(out, "# policy\tthreads");
+    for (int l = 0; l < SCALING_LEVELS; l++)
+        fprintf(out, "\t%s_total\t%s_per_thread", level_names[l], level_names[l]);
+    fprintf(out, "\n");
+
+    for (int policy = 0; policy < NUM_PLACEMENTS; policy++) {
+        order_cpus(cpus, n, policy, order);
+        memcpy(prev[policy], order, n * sizeof(int));
+
+        int same = -1;
+        for (int p = 0; p < policy && same < 0; p++)
+            if (memcmp(prev[p], order, n * sizeof(int)) == 0) same = p;
+        if (same >= 0) {
+            fprintf(out, "# %s: same CPU order as %s, skipped\n",
+                    placement_names[policy], placement_names[same]);
+            continue;
+        }
+
+        struct bw_worker *w = start_bw_workers(order, n, kind);
+        if (!w) break;
+
+        double totals[SCALING_MAX_COUNTS][SCALING_LEVELS];
+        for (int c = 0; c < num_counts; c++) {
+            int threads = counts[c];
+            fprintf(out, "%s\t%d", placement_names[policy], threads);
+
+            for (int l = 0; l < SCALING_LEVELS; l++) {
+                size_t bytes = l == 0 ? l1 / 2 : l == 1 ? l2 / 2 :
+                               l == 2 ? l3 / 2 / threads : dram / threads;
+                bytes = bytes / BW_CHUNK * BW_CHUNK;
+                if (bytes < BW_CHUNK) bytes = BW_CHUNK;
+
+                run_bw_workers(w, n, threads, bytes, 0);
+                sleep_sec(0.02);
+                uint64_t moved0 = bw_moved(w, n);
+                double start = now_sec();
+                sleep_sec(0.1);
+                uint64_t moved1 = bw_moved(w, n);
+                double secs = now_sec() - start;
+
+                totals[c][l] = (double)(moved1 - moved0) / secs / 1e9;
+                fprintf(out, "\t%.2f\t%.2f", totals[c][l], totals[c][l] / threads);
+                fflush(out);
+            }
+            fprintf(out, "\n");
+        }
+        run_bw_workers(w, n, 0, 0, 0);
+        stop_bw_workers(w, n);
+
+        /* Fewest threads reaching 90% of the best aggregate */
+        fprintf(out, "# %s saturation:", placement_names[policy]);
+        for (int l = 0; l < SCALING_LEVELS; l++) {
+            double peak = 0;
+            for (int c = 0; c < num_counts; c++)
+                if (totals[c][l] > peak) peak = totals[c][l];
+            int c = 0;
+            while (c < num_counts - 1 && totals[c][l] < 0.9 * peak) c++;
+            fprintf(out, " %s %.1f GB/s at %d threads%s", level_names[l], peak, counts[c],
+                    l < SCALING_LEVELS - 1 ? "," : "\n");
+        }
+    }
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
+
+/* Node IDs from a /sys/devices/system/node list file, {0} if absent */
+static int read_node_list(const char *name, int *nodes, int max) {
+    char path[128], buf[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/%s", name);
+    int n = 0;
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) n = parse_cpu_list(buf, nodes, max);
+    if (n == 0) {
+        nodes[0] = 0;
+        n = 1;
+    }
+    return n;
+}
+
+/* Allowed CPUs on `node`; all allowed CPUs if the node has no cpulist */
+static int node_cpus(int node, const int *allowed, int num_allowed, int *cpus) {
+    char path[128], buf[4096];
+    int list[MAX_CPUS], n = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if (read_sys_string(path, buf, sizeof(buf)) != 0) {
+        memcpy(cpus, allowed, num_allowed * sizeof(int));
+        return num_allowed;
+    }
+    int nl = parse_cpu_list(buf, list, MAX_CPUS);
+    for (int i = 0; i < nl; i++)
+        for (int j = 0; j < num_allowed; j++)
+            if (list[i] == allowed[j]) cpus[n++] = list[i];
+    return n;
+}
+
+static void print_node_matrix(const char *title, const int *rows, int num_rows,
+                              const int *cols, int num_cols, const double *m) {
+    printf("\n=== %s ===\n", title);
+    printf("%-8s", "cpu\\mem");
+    for (int j = 0; j < num_cols; j++) printf("   node%-3d", cols[j]);
+    printf("\n");
+    for (int i = 0; i < num_rows; i++) {
+        printf("node%-4d", rows[i]);
+        for (int j = 0; j < num_cols; j++) {
+            if (m[i * num_cols + j] < 0) printf(" %9s", "-");
+            else printf(" %9.1f", m[i * num_cols + j]);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * NUMA matrices: rows are nodes with allowed CPUs, columns are nodes with
+ * memory. Latency is the DRAM-sized pointer chase from the row's first
+ * CPU over a buffer bound to the column's node; bandwidth is the read
+ * kernel on every CPU of the row node, each over its own bound buffer.
+ */
+int probe_numa_matrix(void) {
+    const size_t ACCESSES = 1 << 21;
+
+    int allowed[MAX_CPUS], mem_nodes[MAX_NODES], cpu_nodes[MAX_NODES], all[MAX_NODES];
+    int num_allowed = allowed_cpus(allowed, MAX_CPUS);
+    int num_mem = read_node_list("has_memory", mem_nodes, MAX_NODES);
+    int num_all = read_node_list("online", all, MAX_NODES);
+    if (num_allowed < 1) return -1;
+
+    int num_cpu_nodes = 0;
+    int *node_cpu_list = (int *)malloc((size_t)num_all * MAX_CPUS * sizeof(int));
+    int node_cpu_count[MAX_NODES];
+    if (!node_cpu_list) return -1;
+    for (int i = 0; i < num_all; i++) {
+        int *list = node_cpu_list + (size_t)num_cpu_nodes * MAX_CPUS;
+        int nc = node_cpus(all[i], allowed, num_allowed, list);
+        if (nc == 0) continue;
+        node_cpu_count[num_cpu_nodes] = nc;
+        cpu_nodes[num_cpu_nodes++] = all[i];
+    }
+
+    size_t llc = last_level_cache_size(), phys = physical_memory();
+    size_t dram = 4 * llc < 256 * 1024 * 1024 ? 256 * 1024 * 1024 : 4 * llc;
+    if (dram > (size_t)1024 * 1024 * 1024) dram = (size_t)1024 * 1024 * 1024;
+    if (dram > phys / 16) dram = phys / 16;
+
+    double *lat = (double *)malloc((size_t)num_cpu_nodes * num_mem * sizeof(double));
+    double *bw = (double *)malloc((size_t)num_cpu_nodes * num_mem * sizeof(double));
+    if (!lat || !bw) {
+        free(node_cpu_list);
+        free(lat);
+        free(bw);
+        return -1;
+    }
+    for (int i = 0; i < num_cpu_nodes * num_mem; i++) lat[i] = bw[i] = -1.0;
+
+    printf("NUMA nodes: %d online, %d with memory, %d with allowed CPUs\n",
+           num_all, num_mem, num_cpu_nodes);
+    if (num_mem == 1 && num_cpu_nodes == 1) printf("Single NUMA node.\n");
+
+    /*
+     * Latency: one chase buffer per memory node, walked from each CPU node.
+     * Every node gets the same single-cycle order so columns differ only
+     * in where the memory lives.
+     */
+    int unbound = 0;
+    for (int j = 0; j < num_mem; j++) {
+        size_t *chase = alloc_buffer(dram);
+        if (!chase) continue;
+        if (bind_to_node(chase, dram, mem_nodes[j]) != 0) unbound = 1;
+        srand(12345);
+        create_pointer_chase(chase, dram / sizeof(size_t));
+
+        for (int i = 0; i < num_cpu_nodes; i++) {
+            pin_to_cpu(node_cpu_list[(size_t)i * MAX_CPUS]);
+            size_t idx = 0;
+            for (size_t a = 0; a < ACCESSES / 8; a++) idx = chase[idx];
+            double start = now_sec();
+            for (size_t a = 0; a < ACCESSES; a++) idx = chase[idx];
+            double secs = now_sec() - start;
+            volatile size_t dummy = idx;
+            (void)dummy;
+            lat[i * num_mem + j] = secs / ACCESSES * 1e9;
+        }
+        free(chase);
+    }
+
+    /* Bandwidth: all CPUs of a node reading memory bound to each node */
+    for (int i = 0; i < num_cpu_nodes; i++) {
+        int nc = node_cpu_count[i];
+        struct bw_worker *w = start_bw_workers(node_cpu_list + (size_t)i * MAX_CPUS, nc, BW_READ);
+        if (!w) continue;
+        size_t bytes = dram / nc / BW_CHUNK * BW_CHUNK;
+        if (bytes < BW_CHUNK) bytes = BW_CHUNK;
+
+        for (int j = 0; j < num_mem; j++) {
+            for (int k = 0; k < nc; k++) w[k].req_node = mem_nodes[j];
+            run_bw_workers(w, nc, nc, bytes, 0);
+            sleep_sec(0.02);
+            uint64_t moved0 = bw_moved(w, nc);
+            double start = now_sec();
+            sleep_sec(0.2);
+            uint64_t moved1 = bw_moved(w, nc);
+            bw[i * num_mem + j] = (double)(moved1 - moved0) / (now_sec() - start) / 1e9;
+        }
+        run_bw_workers(w, nc, 0, 0, 0);
+        stop_bw_workers(w, nc);
+    }
+
+    if (unbound && num_mem > 1)
+        printf("mbind failed; buffers follow the default policy.\n");
+    print_node_matrix("NUMA latency (ns)", cpu_nodes, num_cpu_nodes, mem_nodes, num_mem, lat);
+    print_node_matrix("NUMA read bandwidth (GB/s)", cpu_nodes, num_cpu_nodes, mem_nodes, num_mem, bw);
+
+    free(node_cpu_list);
+    free(lat);
+    free(bw);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    /* cache_info numa: node x node latency and bandwidth */
+    if (argc > 1 && strcmp(argv[1], "numa") == 0)
+        return probe_numa_matrix() != 0;
+
+    /* cache_info scaling [read|write|rmw] [file]: bandwidth vs threads and placement */
+    if (argc > 1 && strcmp(argv[1], "scaling") == 0) {
+        int kind = BW_READ;
+        const char *path = NULL;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "read") == 0) kind = BW_READ;
+            else if (strcmp(argv[i], "write") == 0) kind = BW_WRITE;
+            else if (strcmp(argv[i], "rmw") == 0) kind = BW_RMW;
+            else path = argv[i];
+        }
+        if (probe_bandwidth_scaling(kind, path) != 0) return 1;
+        if (path) printf("Bandwidth scaling written to %s\n", path);
+        return 0;
+    }
+
+    /* cache_info loaded [read|write|rmw] [file]: latency under bandwidth load */
+    if (argc > 1 && strcmp(argv[1], "loaded") == 0) {
+        int kind = BW_READ;
+        const char *path = NULL;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "read") == 0) kind = BW_READ;
+            else if (strcmp(argv[i], "write") == 0) kind = BW_WRITE;
+            else if (strcmp(argv[i], "rmw") == 0) kind = BW_RMW;
+            else path = argv[i];
+        }
+        if (probe_loaded_latency(kind, path) != 0) return 1;
+        if (path) printf("Loaded-latency curve written to %s\n", path);
+        return 0;
+    }
+
+    /* cache_info mountain [file]: stride x working-set throughput grid */
+    if (argc > 1 && strcmp(argv[1], "mountain") == 0) {
+        if (probe_memory_mountain(argc > 2 ? argv[2] : NULL) != 0) return 1;
+        if (argc > 2) printf("Memory mountain written to %s\n", argv[2]);
+        return 0;
+    }
+
     int line_size = probe_cache_line_size();
 
     size_t l1_size, l2_size, l3_size;
@@ -3,15 +3,23 @@
  * Uses macOS QoS classes to target different core types
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 
 #ifdef __APPLE__
 #include <pthread/qos.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
 #if defined(__aarch64__)
 static inline uint64_t get_time(void) {
     uint64_t val;
@@ -34,12 +42,13 @@ static inline void memory_barrier(void) {
 #endif
 }
 
+/* Sattolo's shuffle: one random cycle through every element */
 static void create_pointer_chase(size_t *array, size_t count) {
     for (size_t i = 0; i < count; i++)
-        array[i] = (i + 1) % count;
+        array[i] = i;
 
     for (size_t i = count - 1; i > 0; i--) {
-        size_t j = (size_t)rand() % (i + 1);
+        size_t j = (size_t)rand() % i;
         size_t temp = array[i];
         array[i] = array[j];
         array[j] = temp;
@@ -85,21 +94,23 @@ int probe_cache_line_size(void) {
     return detected;
 }
 
-void probe_cache_sizes(size_t *l1_size, size_t *l2_size) {
-    size_t sizes[] = {
-        8*1024, 16*1024, 32*1024, 48*1024, 64*1024, 96*1024, 128*1024,
-        192*1024, 256*1024, 384*1024, 512*1024, 768*1024, 1024*1024,
-        2*1024*1024, 4*1024*1024, 8*1024*1024, 16*1024*1024
-    };
-    int num_sizes = 17;
-    double times[17];
+static const size_t chase_sizes[] = {
+    8*1024, 16*1024, 32*1024, 48*1024, 64*1024, 96*1024, 128*1024,
+    192*1024, 256*1024, 384*1024, 512*1024, 768*1024, 1024*1024,
+    2*1024*1024, 4*1024*1024, 8*1024*1024, 16*1024*1024,
+    32*1024*1024, 64*1024*1024
+};
+#define NUM_CHASE_SIZES 19
 
+/* Pointer-chase ticks per load at every size in chase_sizes */
+static void probe_chase_curve(double *times) {
     srand(12345);
 
-    for (int s = 0; s < num_sizes; s++) {
-        size_t size = sizes[s];
+    for (int s = 0; s < NUM_CHASE_SIZES; s++) {
+        size_t size = chase_sizes[s];
         size_t count = size / sizeof(size_t);
         size_t *array = (size_t *)malloc(size);
+        times[s] = 0;
         if (!array) break;
 
         create_pointer_chase(array, count);
@@ -118,25 +129,38 @@ void probe_cache_sizes(size_t *l1_size, size_t *l2_size) {
         times[s] = (double)(end - start) / (count * 4);
         free(array);
     }
+}
 
+static void detect_cache_sizes(const double *times, size_t *l1_size, size_t *l2_size, size_t *l3_size) {
     *l1_size = 0;
     *l2_size = 0;
+    *l3_size = 0;
 
-    for (int s = 1; s < num_sizes; s++) {
+    for (int s = 1; s < NUM_CHASE_SIZES; s++) {
+        if (times[s] == 0 || times[s-1] == 0) break;
         double ratio = times[s] / times[s-1];
-        if (*l1_size == 0 && sizes[s-1] <= 128*1024 && ratio > 1.3)
-            *l1_size = sizes[s-1];
-        else if (*l2_size == 0 && sizes[s-1] > 128*1024 && ratio > 1.3)
-            *l2_size = sizes[s-1];
+        size_t prev = chase_sizes[s-1];
+        if (*l1_size == 0 && prev <= 128*1024 && ratio > 1.3)
+            *l1_size = prev;
+        else if (*l2_size == 0 && prev > 128*1024 && prev <= 8*1024*1024 && ratio > 1.3)
+            *l2_size = prev;
+        else if (*l3_size == 0 && *l2_size != 0 && prev > *l2_size && ratio > 1.3)
+            *l3_size = prev;
     }
 }
 
+void probe_cache_sizes(size_t *l1_size, size_t *l2_size, size_t *l3_size) {
+    double times[NUM_CHASE_SIZES];
+    probe_chase_curve(times);
+    detect_cache_sizes(times, l1_size, l2_size, l3_size);
+}
+
 void run_tests(const char *core_type) {
     printf("\n=== %s ===\n", core_type);
 
     int line_size = probe_cache_line_size();
-    size_t l1_size, l2_size;
-    probe_cache_sizes(&l1_size, &l2_size);
+    size_t l1_size, l2_size, l3_size;
+    probe_cache_sizes(&l1_size, &l2_size, &l3_size);
 
     printf("Cache Line Size: %d bytes\n", line_size);
     printf("L1 Data Cache:   %zu KB\n", l1_size / 1024);
@@ -146,9 +170,526 @@ void run_tests(const char *core_type) {
         else
             printf("L2 Cache:        %zu KB\n", l2_size / 1024);
     }
+    if (l3_size > 0)
+        printf("L3 Cache:        %zu MB\n", l3_size / (1024*1024));
+}
+
+#define MAX_CPUS 1024
+
+/* CPUs this process may run on, ascending. Returns the count. */
+static int allowed_cpus(int *cpus, int max) {
+    int n = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++)
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        return n;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int c = 0; c < online && n < max; c++)
+        cpus[n++] = c;
+    return n;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success. */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+/* Parse a kernel CPU list such as "0-3,8,10-11". Returns the count. */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++)
+            cpus[n++] = (int)c;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+/* sysfs shared_cpu_list of `cpu`'s data or unified cache at `level`, -1 if absent */
+static int sysfs_shared_cpus(int cpu, int level, int *cpus, int max) {
+    char path[128], buf[4096];
+    for (int idx = 0; idx < 8; idx++) {
+        FILE *f;
+        int lvl = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+        if (!(f = fopen(path, "r"))) break;
+        if (fscanf(f, "%d", &lvl) != 1) lvl = 0;
+        fclose(f);
+        if (lvl != level) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, idx);
+        if ((f = fopen(path, "r"))) {
+            if (!fgets(buf, sizeof(buf), f)) buf[0] = '\0';
+            fclose(f);
+            if (strncmp(buf, "Instruction", 11) == 0) continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (!(f = fopen(path, "r"))) return -1;
+        int n = fgets(buf, sizeof(buf), f) ? parse_cpu_list(buf, cpus, max) : -1;
+        fclose(f);
+        return n;
+    }
+    return -1;
+}
+
+/* Average ticks per load of a pointer chase, at least `min_accesses` long */
+static double chase_ticks(const size_t *array, size_t count, size_t min_accesses) {
+    size_t accesses = count * 4 > min_accesses ? count * 4 : min_accesses;
+    size_t idx = 0;
+    for (size_t i = 0; i < count; i++)
+        idx = array[idx];
+
+    memory_barrier();
+    uint64_t start = get_time();
+    for (size_t i = 0; i < accesses; i++)
+        idx = array[idx];
+    memory_barrier();
+    uint64_t end = get_time();
+
+    volatile size_t dummy = idx; (void)dummy;
+    return (double)(end - start) / accesses;
+}
+
+/*
+ * Cache-thrashing load on its own CPU until told to stop:
+ *   AGG_STREAM  sequential lines through the whole buffer
+ *   AGG_RANDOM  independent loads of random lines (DRAM traffic)
+ *   AGG_TLB     one line from a random 4KB page (page walks, little data)
+ */
+enum aggressor_kind { AGG_STREAM, AGG_RANDOM, AGG_TLB };
+
+struct aggressor {
+    pthread_t thread;
+    int cpu;
+    int kind;
+    volatile char *buf;
+    size_t bytes;
+    volatile int running;
+    volatile int stop;
+};
+
+static void *aggressor_thread(void *arg) {
+    struct aggressor *a = (struct aggressor *)arg;
+    pin_to_cpu(a->cpu);
+    char sum = 0;
+    uint64_t x = 88172645463325252ULL + (uint64_t)a->cpu;
+    size_t lines = a->bytes / 64, pages = a->bytes / 4096;
+    while (!a->stop) {
+        if (a->kind == AGG_STREAM) {
+            for (size_t i = 0; i < a->bytes; i += 64)
+                sum += a->buf[i];
+        } else {
+            for (int i = 0; i < 4096; i++) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                if (a->kind == AGG_RANDOM)
+                    sum += a->buf[(x % lines) * 64];
+                else
+                    sum += a->buf[(x % pages) * 4096 + (x >> 58) * 64];
+            }
+        }
+        a->running = 1;
+    }
+    a->buf[0] = sum;
+    return NULL;
+}
+
+#define CONTENTION_ACCESSES (1 << 21)
+#define CONTENTION_RATIO 1.3
+
+/*
+ * Victim chase slowdown on the calling thread's CPU while `cpu` streams
+ * `agg_bytes`. A victim set of half a cache survives a private
+ * neighbour but is evicted by one sharing that cache.
+ */
+static double contention_ratio(const size_t *victim, size_t count, double alone,
+                               int cpu, volatile char *agg_buf, size_t agg_bytes) {
+    struct aggressor a = { .cpu = cpu, .buf = agg_buf, .bytes = agg_bytes };
+    if (pthread_create(&a.thread, NULL, aggressor_thread, &a) != 0) return 0.0;
+    while (!a.running) ;
+    double loaded = chase_ticks(victim, count, CONTENTION_ACCESSES);
+    a.stop = 1;
+    pthread_join(a.thread, NULL);
+    return loaded / alone;
+}
+
+static void print_cpu_set(const int *cpus, int n) {
+    for (int i = 0; i < n; i++)
+        printf("%s%d", i ? "," : "", cpus[i]);
+}
+
+/*
+ * Group allowed CPUs by which ones evict each other's `cache_size`/2
+ * working set. Each ungrouped CPU probes only the CPUs not yet placed,
+ * so the cost is about N^2/2 pairs in the worst (all-private) case.
+ */
+static void discover_sharing(const int *cpus, int n, int level, size_t cache_size) {
+    printf("\n=== L%d sharing (measured %zu KB) ===\n", level, cache_size / 1024);
+
+    size_t count = cache_size / 2 / sizeof(size_t);
+    size_t *victim = (size_t *)malloc(count * sizeof(size_t));
+    volatile char *agg_buf = (volatile char *)malloc(cache_size);
+    int *group = (int *)malloc(n * sizeof(int));
+    if (!victim || !agg_buf || !group) {
+        free(victim); free((void *)agg_buf); free(group);
+        return;
+    }
+    create_pointer_chase(victim, count);
+    for (size_t i = 0; i < cache_size; i++)
+        agg_buf[i] = (char)i;
+    for (int i = 0; i < n; i++)
+        group[i] = -1;
+
+    int num_groups = 0, agree = 0, differ = 0, missing = 0;
+    for (int i = 0; i < n; i++) {
+        if (group[i] >= 0) continue;
+        group[i] = num_groups;
+        pin_to_cpu(cpus[i]);
+        double alone = chase_ticks(victim, count, CONTENTION_ACCESSES);
+        for (int j = i + 1; j < n; j++) {
+            if (group[j] >= 0) continue;
+            if (contention_ratio(victim, count, alone, cpus[j], agg_buf, cache_size) > CONTENTION_RATIO)
+                group[j] = num_groups;
+        }
+
+        int members[MAX_CPUS], num_members = 0;
+        for (int j = 0; j < n; j++)
+            if (group[j] == num_groups) members[num_members++] = cpus[j];
+
+        /* sysfs view, restricted to the CPUs we could test */
+        int listed[MAX_CPUS], sys[MAX_CPUS], num_sys = 0;
+        int num_listed = sysfs_shared_cpus(cpus[i], level, listed, MAX_CPUS);
+        for (int k = 0; k < num_listed; k++)
+            for (int j = 0; j < n; j++)
+                if (listed[k] == cpus[j]) sys[num_sys++] = listed[k];
+
+        printf("CPUs ");
+        print_cpu_set(members, num_members);
+        if (num_listed < 0) {
+            printf("  (sysfs: missing)\n");
+            missing++;
+        } else if (num_sys == num_members && memcmp(sys, members, num_sys * sizeof(int)) == 0) {
+            printf("  (sysfs: match)\n");
+            agree++;
+        } else {
+            printf("  (sysfs: ");
+            print_cpu_set(sys, num_sys);
+            printf(")\n");
+            differ++;
+        }
+        num_groups++;
+    }
+    printf("%d groups: %d match sysfs, %d differ, %d missing from sysfs\n",
+           num_groups, agree, differ, missing);
+
+    free(victim);
+    free((void *)agg_buf);
+    free(group);
+}
+
+/* Which CPUs share L2 and L3, from capacity interference rather than sysfs */
+void run_sharing(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+
+    size_t l1_size, l2_size, l3_size;
+    probe_cache_sizes(&l1_size, &l2_size, &l3_size);
+
+    printf("=== Cache sharing by contention (%d CPUs) ===\n", n);
+    if (n < 1 || pin_to_cpu(cpus[0]) != 0) {
+        printf("CPU pinning requires Linux (sched_setaffinity).\n");
+        return;
+    }
+    if (n < 2)
+        printf("Only one CPU available; every cache is trivially private.\n");
+
+    if (l2_size > 0)
+        discover_sharing(cpus, n, 2, l2_size);
+    if (l3_size > 0)
+        discover_sharing(cpus, n, 3, l3_size);
+}
+
+static void print_size(size_t size) {
+    if (size == 0)
+        printf(" %7s", "-");
+    else if (size >= 1024*1024)
+        printf(" %4zu MB", size / (1024*1024));
+    else
+        printf(" %4zu KB", size / 1024);
+}
+
+/* Index of the largest chase size not above `size` */
+static int chase_index(size_t size) {
+    int s = 0;
+    while (s + 1 < NUM_CHASE_SIZES && chase_sizes[s + 1] <= size)
+        s++;
+    return s;
+}
+
+static const char *aggressor_names[] = { "llc", "dram", "tlb" };
+
+/* Chase sizes at half of each baseline level, plus the largest (memory) */
+static void latency_points(const size_t *base_sizes, int *probe_at) {
+    for (int l = 0; l < 3; l++)
+        probe_at[l] = base_sizes[l] ? chase_index(base_sizes[l] / 2) : -1;
+    probe_at[3] = NUM_CHASE_SIZES - 1;
+}
+
+/* Detected sizes, then latency at each probe point and its ratio to baseline */
+static void print_shift(const size_t *sizes, const double *times, const int *probe_at,
+                        const double *base_times) {
+    for (int l = 0; l < 3; l++)
+        print_size(sizes[l]);
+    printf(" |");
+    for (int l = 0; l < 4; l++) {
+        int s = probe_at[l];
+        if (s < 0 || base_times[s] == 0)
+            printf("%12s", "-");
+        else
+            printf("%6.0f %4.1fx", times[s], times[s] / base_times[s]);
+    }
+    printf("\n");
+}
+
+/*
+ * Noisy neighbour: rerun probe_cache_sizes on the victim CPU while 1, 2,
+ * 4, ... antagonists of one kind run on the other CPUs. LLC streams get
+ * a buffer of the baseline LLC size each; DRAM and TLB antagonists share
+ * one read-only 256MB buffer, kept on 4KB pages for the TLB case.
+ * Latency is read at half of each baseline level and at the largest size.
+ */
+static void run_noisy_kind(const int *cpus, int kind, int max_threads,
+                           const size_t *base_sizes, const double *base_times) {
+    const size_t SHARED_BYTES = 256 * 1024 * 1024;
+    size_t llc = base_sizes[2] ? base_sizes[2] : base_sizes[1] ? base_sizes[1] : 32 * 1024 * 1024;
+    int probe_at[4];
+    latency_points(base_sizes, probe_at);
+
+    printf("\n=== Noisy neighbour: %s antagonists, victim CPU %d ===\n",
+           aggressor_names[kind], cpus[0]);
+    printf("threads      L1      L2      L3 |%12s%12s%12s%12s  (ticks, x idle)\n",
+           "lat L1", "lat L2", "lat L3", "lat mem");
+
+    struct aggressor *aggs = (struct aggressor *)calloc(max_threads + 1, sizeof(*aggs));
+    volatile char *shared = NULL;
+    if (kind != AGG_STREAM) {
+        shared = (volatile char *)aligned_alloc(4096, SHARED_BYTES);
+#if defined(__linux__) && defined(MADV_NOHUGEPAGE)
+        if (shared && kind == AGG_TLB)
+            madvise((void *)shared, SHARED_BYTES, MADV_NOHUGEPAGE);
+#endif
+        if (shared)
+            for (size_t i = 0; i < SHARED_BYTES; i += 64)
+                shared[i] = (char)i;
+    }
+    if (!aggs || (kind != AGG_STREAM && !shared)) {
+        free(aggs); free((void *)shared);
+        return;
+    }
+
+    for (int t = 0; t <= max_threads; t = t ? t * 2 : 1) {
+        if (t > max_threads / 2 && t < max_threads) t = max_threads;
+
+        int started = 0;
+        for (int i = 0; i < t; i++) {
+            struct aggressor *a = &aggs[i];
+            memset(a, 0, sizeof(*a));
+            a->cpu = cpus[1 + i];
+            a->kind = kind;
+            a->bytes = kind == AGG_STREAM ? llc : SHARED_BYTES;
+            a->buf = kind == AGG_STREAM ? (volatile char *)malloc(llc) : shared;
+            if (!a->buf) break;
+            if (kind == AGG_STREAM)
+                for (size_t j = 0; j < llc; j += 64)
+                    a->buf[j] = (char)j;
+            if (pthread_create(&a->thread, NULL, aggressor_thread, a) != 0) {
+                if (kind == AGG_STREAM)
+                    free((void *)a->buf);
+                break;
+            }
+            started++;
+        }
+        for (int i = 0; i < started; i++)
+            while (!aggs[i].running) ;
+
+        double times[NUM_CHASE_SIZES];
+        size_t sizes[3];
+        probe_chase_curve(times);
+        detect_cache_sizes(times, &sizes[0], &sizes[1], &sizes[2]);
+
+        for (int i = 0; i < started; i++) {
+            aggs[i].stop = 1;
+            pthread_join(aggs[i].thread, NULL);
+            if (kind == AGG_STREAM)
+                free((void *)aggs[i].buf);
+        }
+
+        printf("%7d", started);
+        print_shift(sizes, times, probe_at, base_times);
+
+        if (t == max_threads) break;
+    }
+
+    free(aggs);
+    free((void *)shared);
+}
+
+/* cache_info_cores noisy [llc|dram|tlb|all] [max_threads] */
+void run_noisy(const char *which, int max_threads) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    if (n < 1 || pin_to_cpu(cpus[0]) != 0) {
+        printf("CPU pinning requires Linux (sched_setaffinity).\n");
+        return;
+    }
+    if (max_threads <= 0 || max_threads > n - 1)
+        max_threads = n - 1;
+    if (n < 2)
+        printf("Only one CPU available; antagonists would share the victim's core.\n");
+
+    double base_times[NUM_CHASE_SIZES];
+    size_t base_sizes[3];
+    probe_chase_curve(base_times);
+    detect_cache_sizes(base_times, &base_sizes[0], &base_sizes[1], &base_sizes[2]);
+
+    printf("Idle victim: L1");
+    print_size(base_sizes[0]);
+    printf(", L2");
+    print_size(base_sizes[1]);
+    printf(", L3");
+    print_size(base_sizes[2]);
+    printf("\n");
+
+    for (int kind = AGG_STREAM; kind <= AGG_TLB; kind++)
+        if (strcmp(which, "all") == 0 || strcmp(which, aggressor_names[kind]) == 0)
+            run_noisy_kind(cpus, kind, max_threads, base_sizes, base_times);
+}
+
+/* First allowed SMT sibling of `cpu` from sysfs thread_siblings_list, -1 if none */
+static int smt_sibling(int cpu, const int *allowed, int n) {
+    char path[128], buf[4096];
+    int siblings[MAX_CPUS], num = -1;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (fgets(buf, sizeof(buf), f))
+        num = parse_cpu_list(buf, siblings, MAX_CPUS);
+    fclose(f);
+    for (int i = 0; i < num; i++) {
+        if (siblings[i] == cpu)
+            continue;
+        for (int j = 0; j < n; j++)
+            if (allowed[j] == siblings[i])
+                return siblings[i];
+    }
+    return -1;
+}
+
+static const char *smt_load_names[] = { "idle", "l1", "l2", "stream" };
+#define NUM_SMT_LOADS 4
+
+/*
+ * cache_info_cores smt [l1|l2|stream|all]
+ * SMT interference: rerun probe_cache_sizes on one hardware thread while
+ * its sibling streams a buffer sized to stay in L1 (half the baseline
+ * L1), in L2 (half the baseline L2), or to miss everything (4x LLC).
+ * Siblings share L1 and L2 capacity, so the knees move down by what the
+ * sibling keeps resident, and its misses queue with the victim's.
+ */
+void run_smt(const char *which) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    int victim = -1, sibling = -1;
+    for (int i = 0; i < n && sibling < 0; i++) {
+        sibling = smt_sibling(cpus[i], cpus, n);
+        victim = cpus[i];
+    }
+    if (sibling < 0 || pin_to_cpu(victim) != 0) {
+        printf("No SMT sibling pair among the allowed CPUs (thread_siblings_list).\n");
+        return;
+    }
+
+    double base_times[NUM_CHASE_SIZES];
+    size_t base_sizes[3];
+    probe_chase_curve(base_times);
+    detect_cache_sizes(base_times, &base_sizes[0], &base_sizes[1], &base_sizes[2]);
+    int probe_at[4];
+    latency_points(base_sizes, probe_at);
+
+    size_t llc = base_sizes[2] ? base_sizes[2] : base_sizes[1] ? base_sizes[1] : 32 * 1024 * 1024;
+    size_t load_bytes[NUM_SMT_LOADS] = {
+        0,
+        (base_sizes[0] ? base_sizes[0] : 32 * 1024) / 2,
+        (base_sizes[1] ? base_sizes[1] : 1024 * 1024) / 2,
+        llc * 4,
+    };
+
+    printf("=== SMT sibling interference: victim CPU %d, sibling CPU %d ===\n", victim, sibling);
+    printf("sibling      L1      L2      L3 |%12s%12s%12s%12s  (ticks, x idle)\n",
+           "lat L1", "lat L2", "lat L3", "lat mem");
+    for (int k = 0; k < NUM_SMT_LOADS; k++) {
+        if (k > 0 && strcmp(which, "all") != 0 && strcmp(which, smt_load_names[k]) != 0)
+            continue;
+        double times[NUM_CHASE_SIZES];
+        size_t sizes[3];
+        if (k == 0) {
+            memcpy(times, base_times, sizeof(times));
+            memcpy(sizes, base_sizes, sizeof(sizes));
+        } else {
+            struct aggressor a = { .cpu = sibling, .kind = AGG_STREAM, .bytes = load_bytes[k] };
+            a.buf = (volatile char *)malloc(a.bytes);
+            if (!a.buf)
+                continue;
+            for (size_t j = 0; j < a.bytes; j += 64)
+                a.buf[j] = (char)j;
+            if (pthread_create(&a.thread, NULL, aggressor_thread, &a) != 0) {
+                free((void *)a.buf);
+                continue;
+            }
+            while (!a.running) ;
+            probe_chase_curve(times);
+            detect_cache_sizes(times, &sizes[0], &sizes[1], &sizes[2]);
+            a.stop = 1;
+            pthread_join(a.thread, NULL);
+            free((void *)a.buf);
+        }
+        printf("%-7s", smt_load_names[k]);
+        print_shift(sizes, times, probe_at, base_times);
+    }
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "sharing") == 0) {
+        run_sharing();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "noisy") == 0) {
+        run_noisy(argc > 2 ? argv[2] : "all", argc > 3 ? atoi(argv[3]) : 0);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "smt") == 0) {
+        run_smt(argc > 2 ? argv[2] : "all");
+        return 0;
+    }
+
 #ifdef __APPLE__
     /* Run on P-cores (high priority) */
     pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
@@ -0,0 +1,1611 @@
+/*
+ * Cache Coherence Probes
+ * Measures cache-line transfer costs between cores using pinned threads
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <setjmp.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* High-resolution timing */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t get_time(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t get_time(void) {
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+static inline uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline void memory_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("mfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("dmb sy" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/* Spin-wait hint */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+static double ticks_per_ns = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+/* Detect cache line size via strided access */
+int probe_cache_line_size(void) {
+    const size_t ARRAY_SIZE = 32 * 1024 * 1024;
+    const int ITERATIONS = 3;
+
+    volatile char *array = (volatile char *)malloc(ARRAY_SIZE);
+    if (!array) return 64;
+
+    for (size_t i = 0; i < ARRAY_SIZE; i++) {
+        array[i] = (char)i;
+    }
+
+    int strides[] = {8, 16, 32, 64, 128, 256, 512, 1024};
+    int num_strides = sizeof(strides) / sizeof(strides[0]);
+    double norm_times[10];
+
+    for (int s = 0; s < num_strides; s++) {
+        int stride = strides[s];
+        size_t num_accesses = ARRAY_SIZE / stride;
+        volatile char sum = 0;
+        uint64_t total_time = 0;
+
+        for (int iter = 0; iter < ITERATIONS; iter++) {
+            memory_barrier();
+            uint64_t start = get_time();
+            memory_barrier();
+
+            for (size_t i = 0; i < num_accesses; i++) {
+                sum += array[i * stride];
+            }
+
+            memory_barrier();
+            uint64_t end = get_time();
+            total_time += (end - start);
+        }
+
+        double avg_time = (double)total_time / (ITERATIONS * num_accesses);
+        norm_times[s] = avg_time * stride;
+        (void)sum;
+    }
+
+    int detected = 64;
+    for (int s = 2; s < num_strides - 1; s++) {
+        double growth_before = norm_times[s] / norm_times[s-1];
+        double growth_after = norm_times[s+1] / norm_times[s];
+        if (growth_before > 1.3 && growth_after < 1.3) {
+            detected = strides[s];
+            break;
+        }
+    }
+
+    free((void *)array);
+    return detected;
+}
+
+#define MAX_CPUS 1024
+
+/* CPUs this process may run on, ascending. Returns the count. */
+static int allowed_cpus(int *cpus, int max) {
+    int n = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++)
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        return n;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int c = 0; c < online && n < max; c++) cpus[n++] = c;
+    return n;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success. */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+/* Read one line of a sysfs file. Returns 0 on success. */
+static int read_sys_string(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* Parse a kernel CPU list such as "0-3,8,10-11". Returns the count. */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int cpu_in_list(int cpu, const int *list, int n) {
+    for (int i = 0; i < n; i++)
+        if (list[i] == cpu) return 1;
+    return 0;
+}
+
+/* CPUs sharing `cpu`'s SMT core, last-level cache or package */
+struct cpu_topology {
+    int siblings[MAX_CPUS];
+    int num_siblings;
+    int llc[MAX_CPUS];
+    int num_llc;
+    int package;
+    int core;                       /* topology/core_id */
+    int thread;                     /* index among its SMT siblings */
+};
+
+static void read_cpu_topology(int cpu, struct cpu_topology *t) {
+    char path[128], buf[4096];
+    memset(t, 0, sizeof(*t));
+    t->package = -1;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0)
+        t->num_siblings = parse_cpu_list(buf, t->siblings, MAX_CPUS);
+    for (int i = 0; i < t->num_siblings; i++)
+        if (t->siblings[i] == cpu) t->thread = i;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) t->core = atoi(buf);
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) t->package = atoi(buf);
+
+    /* The highest cache level listed is the LLC */
+    int best_level = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) break;
+        int level = atoi(buf);
+        if (level < best_level) continue;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) continue;
+        best_level = level;
+        t->num_llc = parse_cpu_list(buf, t->llc, MAX_CPUS);
+    }
+}
+
+enum pair_class { PAIR_SMT, PAIR_LLC, PAIR_SOCKET, NUM_PAIRS };
+static const char *pair_names[NUM_PAIRS] = { "SMT sibling", "same LLC", "cross-socket" };
+
+/* One partner of `src` per distance class among `cpus`, -1 where none */
+static void pick_pair_cpus(const int *cpus, int n, int src, int *dst) {
+    struct cpu_topology topo;
+    read_cpu_topology(src, &topo);
+    for (int p = 0; p < NUM_PAIRS; p++) dst[p] = -1;
+    for (int i = 0; i < n; i++) {
+        int c = cpus[i];
+        if (c == src) continue;
+        if (cpu_in_list(c, topo.siblings, topo.num_siblings)) {
+            if (dst[PAIR_SMT] < 0) dst[PAIR_SMT] = c;
+        } else if (cpu_in_list(c, topo.llc, topo.num_llc)) {
+            if (dst[PAIR_LLC] < 0) dst[PAIR_LLC] = c;
+        } else if (dst[PAIR_SOCKET] < 0) {
+            struct cpu_topology other;
+            read_cpu_topology(c, &other);
+            if (other.package >= 0 && other.package != topo.package) dst[PAIR_SOCKET] = c;
+        }
+    }
+}
+
+/* One cache line, padded so the adjacent-line prefetcher can't pair it */
+struct shared_line {
+    volatile uint64_t value;
+    char pad[128 - sizeof(uint64_t)];
+} __attribute__((aligned(128)));
+
+struct pingpong {
+    struct shared_line line;
+    struct shared_line ready;
+    int cpu[2];
+    double round_trip_ns;           /* best of SAMPLES, -1 if pinning failed */
+};
+
+#define PINGPONG_ROUNDS 1000
+#define PINGPONG_SAMPLES 5
+
+/*
+ * Pong side: wait for each odd value and answer with the next even one,
+ * so every round trip moves the line to the other core and back.
+ */
+static void *pong_thread(void *arg) {
+    struct pingpong *pp = (struct pingpong *)arg;
+    if (pin_to_cpu(pp->cpu[1]) != 0) {
+        __atomic_store_n(&pp->ready.value, 2, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    __atomic_store_n(&pp->ready.value, 1, __ATOMIC_RELEASE);
+
+    uint64_t total = (uint64_t)PINGPONG_ROUNDS * PINGPONG_SAMPLES;
+    for (uint64_t k = 1; k <= total; k++) {
+        uint64_t v;
+        while ((v = __atomic_load_n(&pp->line.value, __ATOMIC_ACQUIRE)) != 2 * k - 1) {
+            if (v == UINT64_MAX) return NULL;
+            cpu_relax();
+        }
+        __atomic_store_n(&pp->line.value, 2 * k, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* Ping side: time PINGPONG_ROUNDS round trips per sample */
+static void *ping_thread(void *arg) {
+    struct pingpong *pp = (struct pingpong *)arg;
+    pp->round_trip_ns = -1.0;
+
+    uint64_t ready;
+    while ((ready = __atomic_load_n(&pp->ready.value, __ATOMIC_ACQUIRE)) == 0)
+        cpu_relax();
+    if (ready != 1 || pin_to_cpu(pp->cpu[0]) != 0) {
+        /* Release the pong side if it is waiting */
+        __atomic_store_n(&pp->line.value, UINT64_MAX, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    uint64_t k = 1;
+    for (int s = 0; s < PINGPONG_SAMPLES; s++) {
+        memory_barrier();
+        uint64_t start = get_time();
+        for (int r = 0; r < PINGPONG_ROUNDS; r++, k++) {
+            __atomic_store_n(&pp->line.value, 2 * k - 1, __ATOMIC_RELEASE);
+            while (__atomic_load_n(&pp->line.value, __ATOMIC_ACQUIRE) != 2 * k)
+                cpu_relax();
+        }
+        uint64_t end = get_time();
+
+        double ns = (double)(end - start) / ticks_per_ns / PINGPONG_ROUNDS;
+        if (pp->round_trip_ns < 0 || ns < pp->round_trip_ns) pp->round_trip_ns = ns;
+    }
+    return NULL;
+}
+
+/*
+ * Start the ping-pong of every pair in `pps` at once and wait for all.
+ * A pair whose threads could not both start is left unmeasured.
+ */
+static void run_pingpongs(struct pingpong *pps, int n) {
+    pthread_t threads[2 * MAX_CPUS];
+    int started[2 * MAX_CPUS];
+    for (int i = 0; i < n; i++) {
+        memset(&pps[i].line, 0, sizeof(pps[i].line));
+        memset(&pps[i].ready, 0, sizeof(pps[i].ready));
+        pps[i].round_trip_ns = -1.0;
+        started[2 * i + 1] = pthread_create(&threads[2 * i + 1], NULL, pong_thread, &pps[i]) == 0;
+        /* Without a pong side the ping side would wait forever; tell it to give up */
+        if (!started[2 * i + 1]) __atomic_store_n(&pps[i].ready.value, 2, __ATOMIC_RELEASE);
+        started[2 * i] = pthread_create(&threads[2 * i], NULL, ping_thread, &pps[i]) == 0;
+        /* Release a pong side left waiting for a ping that never comes */
+        if (!started[2 * i]) __atomic_store_n(&pps[i].line.value, UINT64_MAX, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < 2 * n; i++)
+        if (started[i]) pthread_join(threads[i], NULL);
+}
+
+/*
+ * Core-to-core round-trip latency matrix. Pairs are scheduled as a
+ * round-robin tournament (circle method): N-1 rounds in which every CPU
+ * meets one partner, covering each unordered pair exactly once. Round
+ * trips are symmetric, so the upper triangle fills the lower. By default
+ * the pairs of a round run one after another; with `parallel` the whole
+ * round runs at once, since its pairs share no CPU, which cuts a
+ * 128-CPU host to 127 timed steps at the cost of some interconnect noise.
+ * matrix[i * n + j] is in ns, -1 where not measured.
+ */
+int probe_c2c_matrix(const int *cpus, int n, int parallel, double *matrix) {
+    for (int i = 0; i < n * n; i++) matrix[i] = -1.0;
+    if (n < 2) return 0;
+
+    /* Circle method needs an even count; the extra slot is a bye */
+    int slots = n + (n & 1);
+    int *ring = (int *)malloc(slots * sizeof(int));
+    struct pingpong *pps = (struct pingpong *)aligned_alloc(128, (slots / 2) * sizeof(*pps));
+    if (!ring || !pps) {
+        free(ring);
+        free(pps);
+        return -1;
+    }
+    for (int i = 0; i < slots; i++) ring[i] = i < n ? i : -1;
+
+    for (int round = 0; round < slots - 1; round++) {
+        int np = 0;
+        for (int k = 0; k < slots / 2; k++) {
+            int a = ring[k], b = ring[slots - 1 - k];
+            if (a < 0 || b < 0) continue;
+            pps[np].cpu[0] = cpus[a < b ? a : b];
+            pps[np].cpu[1] = cpus[a < b ? b : a];
+            np++;
+        }
+
+        if (parallel) {
+            run_pingpongs(pps, np);
+        } else {
+            for (int p = 0; p < np; p++) run_pingpongs(&pps[p], 1);
+        }
+
+        for (int p = 0; p < np; p++) {
+            int i = 0, j = 0;
+            while (cpus[i] != pps[p].cpu[0]) i++;
+            while (cpus[j] != pps[p].cpu[1]) j++;
+            matrix[i * n + j] = matrix[j * n + i] = pps[p].round_trip_ns;
+        }
+
+        /* Rotate every slot but the first */
+        int last = ring[slots - 1];
+        memmove(&ring[2], &ring[1], (slots - 2) * sizeof(int));
+        ring[1] = last;
+    }
+
+    free(ring);
+    free(pps);
+    return 0;
+}
+
+static void print_c2c_matrix(const int *cpus, int n, const double *matrix, FILE *out) {
+    fprintf(out, "%6s", "cpu");
+    for (int j = 0; j < n; j++) fprintf(out, " %6d", cpus[j]);
+    fprintf(out, "\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%6d", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (matrix[i * n + j] < 0)
+                fprintf(out, " %6s", "-");
+            else
+                fprintf(out, " %6.1f", matrix[i * n + j]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static void run_matrix(int argc, char **argv) {
+    int parallel = 0;
+    const char *path = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "parallel") == 0) parallel = 1;
+        else path = argv[i];
+    }
+
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    double *matrix = (double *)malloc((size_t)n * n * sizeof(double));
+    if (!matrix) return;
+
+    printf("=== Core-to-core round-trip latency (ns), %d CPUs%s ===\n",
+           n, parallel ? ", rounds in parallel" : "");
+    if (n < 2) printf("Only one CPU available; nothing to ping-pong.\n");
+    probe_c2c_matrix(cpus, n, parallel, matrix);
+    print_c2c_matrix(cpus, n, matrix, stdout);
+
+    double lo = -1, hi = -1, sum = 0;
+    int count = 0, failed = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            double v = matrix[i * n + j];
+            if (v < 0) { failed++; continue; }
+            if (lo < 0 || v < lo) lo = v;
+            if (v > hi) hi = v;
+            sum += v;
+            count++;
+        }
+    }
+    if (count > 0)
+        printf("\nMin %.1f ns, max %.1f ns, mean %.1f ns over %d pairs\n",
+               lo, hi, sum / count, count);
+    if (failed > 0)
+        printf("%d pairs could not be started or pinned\n", failed);
+
+    if (path) {
+        FILE *f = fopen(path, "w");
+        if (f) {
+            print_c2c_matrix(cpus, n, matrix, f);
+            fclose(f);
+            printf("Matrix written to %s\n", path);
+        } else {
+            perror(path);
+        }
+    }
+    free(matrix);
+}
+
+/* Evict a line from every cache in the coherence domain */
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_FLUSH 1
+static inline void flush_line(const void *p) {
+    __asm__ __volatile__ ("clflush (%0)" :: "r"(p) : "memory");
+}
+#elif defined(__aarch64__)
+#define HAVE_FLUSH 1
+static inline void flush_line(const void *p) {
+    __asm__ __volatile__ ("dc civac, %0" :: "r"(p) : "memory");
+}
+#else
+#define HAVE_FLUSH 0
+static inline void flush_line(const void *p) {
+    (void)p;
+}
+#endif
+
+#define MESI_LINES 256
+#define MESI_STRIDE 128             /* keep adjacent-line prefetch out of it */
+#define MESI_TRIALS 51
+
+enum agent_cmd { CMD_NONE, CMD_READ, CMD_WRITE, CMD_EXIT };
+
+/* A pinned thread that reads or writes the probe lines on request */
+struct agent {
+    pthread_t thread;
+    int cpu;
+    int pinned;
+    volatile int started;
+    volatile int cmd;
+    char *buf;
+};
+
+static void *agent_thread(void *arg) {
+    struct agent *a = (struct agent *)arg;
+    a->pinned = pin_to_cpu(a->cpu) == 0;
+    __atomic_store_n(&a->started, 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        int cmd;
+        while ((cmd = __atomic_load_n(&a->cmd, __ATOMIC_ACQUIRE)) == CMD_NONE)
+            cpu_relax();
+        if (cmd == CMD_EXIT) break;
+
+        size_t sum = 0;
+        for (int i = 0; i < MESI_LINES; i++) {
+            volatile size_t *line = (volatile size_t *)(a->buf + i * MESI_STRIDE);
+            if (cmd == CMD_READ) sum += line[0];
+            else line[1] = (size_t)i;
+        }
+        memory_barrier();
+        (void)sum;
+        __atomic_store_n(&a->cmd, CMD_NONE, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static int start_agent(struct agent *a, int cpu, char *buf) {
+    memset(a, 0, sizeof(*a));
+    a->cpu = cpu;
+    a->buf = buf;
+    if (pthread_create(&a->thread, NULL, agent_thread, a) != 0) return -1;
+    while (!__atomic_load_n(&a->started, __ATOMIC_ACQUIRE)) cpu_relax();
+    if (!a->pinned) {
+        __atomic_store_n(&a->cmd, CMD_EXIT, __ATOMIC_RELEASE);
+        pthread_join(a->thread, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+static void agent_do(struct agent *a, int cmd) {
+    __atomic_store_n(&a->cmd, cmd, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&a->cmd, __ATOMIC_ACQUIRE) != CMD_NONE) cpu_relax();
+}
+
+static void stop_agent(struct agent *a) {
+    __atomic_store_n(&a->cmd, CMD_EXIT, __ATOMIC_RELEASE);
+    pthread_join(a->thread, NULL);
+}
+
+/* Link the probe lines into a random cycle so loads serialize */
+static void link_lines(char *buf) {
+    int order[MESI_LINES];
+    for (int i = 0; i < MESI_LINES; i++) order[i] = i;
+    for (int i = MESI_LINES - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (int i = 0; i < MESI_LINES; i++)
+        *(void **)(buf + order[i] * MESI_STRIDE) =
+            buf + order[(i + 1) % MESI_LINES] * MESI_STRIDE;
+}
+
+static void flush_lines(char *buf) {
+    for (int i = 0; i < MESI_LINES; i++) flush_line(buf + i * MESI_STRIDE);
+    memory_barrier();
+}
+
+/* Dependent loads through every line, ns per line */
+static double time_line_loads(char *buf) {
+    void *p = buf;
+    memory_barrier();
+    uint64_t start = get_time();
+    for (int i = 0; i < MESI_LINES; i++) p = *(void **)p;
+    memory_barrier();
+    uint64_t end = get_time();
+    void *volatile sink = p;
+    (void)sink;
+    return (double)(end - start) / ticks_per_ns / MESI_LINES;
+}
+
+/* One store per line, each drained before the next, ns per line */
+static double time_line_stores(char *buf) {
+    memory_barrier();
+    uint64_t start = get_time();
+    for (int i = 0; i < MESI_LINES; i++) {
+        ((volatile size_t *)(buf + i * MESI_STRIDE))[1] = (size_t)i;
+        memory_barrier();
+    }
+    uint64_t end = get_time();
+    return (double)(end - start) / ticks_per_ns / MESI_LINES;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+enum line_state { STATE_M, STATE_E, STATE_S, STATE_I, NUM_STATES };
+static const char *state_names[NUM_STATES] = { "M", "E", "S", "I" };
+
+struct mesi_result {
+    double load_ns[NUM_STATES];     /* -1 where the state can't be prepared */
+    double store_ns[NUM_STATES];
+};
+
+/*
+ * Cache-to-cache latency by coherence state. For each trial the lines are
+ * flushed everywhere, then prepared on `src`: M by writing them, E by
+ * reading them alone, S by reading them on `src` and on a third CPU
+ * `helper`; I leaves them in memory. The calling thread, pinned to `dst`,
+ * then times a dependent-load chase or fenced stores. Medians over
+ * MESI_TRIALS trials. Returns -1 if the threads could not be pinned.
+ */
+int probe_mesi_latency(int src, int dst, int helper, struct mesi_result *res) {
+    for (int s = 0; s < NUM_STATES; s++) res->load_ns[s] = res->store_ns[s] = -1.0;
+    if (pin_to_cpu(dst) != 0) return -1;
+
+    char *buf = (char *)aligned_alloc(4096, MESI_LINES * MESI_STRIDE);
+    if (!buf) return -1;
+    memset(buf, 0, MESI_LINES * MESI_STRIDE);
+    link_lines(buf);
+
+    struct agent source, third;
+    int have_helper = helper >= 0;
+    if (start_agent(&source, src, buf) != 0) {
+        free(buf);
+        return -1;
+    }
+    if (have_helper && start_agent(&third, helper, buf) != 0) have_helper = 0;
+
+    double samples[MESI_TRIALS];
+    for (int state = 0; state < NUM_STATES; state++) {
+        if (!HAVE_FLUSH && state != STATE_M) continue;
+        if (state == STATE_S && !have_helper) continue;
+
+        for (int op = 0; op < 2; op++) {
+            for (int t = 0; t < MESI_TRIALS; t++) {
+                flush_lines(buf);
+                if (state == STATE_M) agent_do(&source, CMD_WRITE);
+                if (state == STATE_E || state == STATE_S) agent_do(&source, CMD_READ);
+                if (state == STATE_S) agent_do(&third, CMD_READ);
+                samples[t] = op == 0 ? time_line_loads(buf) : time_line_stores(buf);
+            }
+            qsort(samples, MESI_TRIALS, sizeof(double), compare_double);
+            if (op == 0) res->load_ns[state] = samples[MESI_TRIALS / 2];
+            else res->store_ns[state] = samples[MESI_TRIALS / 2];
+        }
+    }
+
+    stop_agent(&source);
+    if (have_helper) stop_agent(&third);
+    free(buf);
+    return 0;
+}
+
+/* Local L1 reference: the destination already owns the lines */
+static void probe_local_latency(int cpu, double *load_ns, double *store_ns) {
+    pin_to_cpu(cpu);
+    char *buf = (char *)aligned_alloc(4096, MESI_LINES * MESI_STRIDE);
+    if (!buf) return;
+    memset(buf, 0, MESI_LINES * MESI_STRIDE);
+    link_lines(buf);
+
+    double loads[MESI_TRIALS], stores[MESI_TRIALS];
+    for (int t = 0; t < MESI_TRIALS; t++) {
+        time_line_stores(buf);
+        loads[t] = time_line_loads(buf);
+        stores[t] = time_line_stores(buf);
+    }
+    qsort(loads, MESI_TRIALS, sizeof(double), compare_double);
+    qsort(stores, MESI_TRIALS, sizeof(double), compare_double);
+    *load_ns = loads[MESI_TRIALS / 2];
+    *store_ns = stores[MESI_TRIALS / 2];
+    free(buf);
+}
+
+static void run_mesi(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    int src = cpus[0];
+
+    int dst[NUM_PAIRS];
+    pick_pair_cpus(cpus, n, src, dst);
+
+    printf("=== Cache-to-cache latency by coherence state (ns per line) ===\n");
+    printf("Source CPU %d prepares %d lines; destination times loads and fenced stores\n",
+           src, MESI_LINES);
+    if (!HAVE_FLUSH)
+        printf("No user-space cache flush on this architecture; only M is measured.\n");
+
+    double local_load = 0, local_store = 0;
+    probe_local_latency(src, &local_load, &local_store);
+    printf("Local L1 reference: load %.1f ns, store %.1f ns\n\n", local_load, local_store);
+
+    printf("%-14s %5s", "Pair", "dest");
+    for (int s = 0; s < NUM_STATES; s++) printf("  %s load", state_names[s]);
+    for (int s = 0; s < NUM_STATES; s++) printf(" %s store", state_names[s]);
+    printf("\n");
+
+    for (int p = 0; p < NUM_PAIRS; p++) {
+        printf("%-14s ", pair_names[p]);
+        if (dst[p] < 0) {
+            printf("%5s  not present in the allowed CPU set\n", "-");
+            continue;
+        }
+
+        /* Shared state needs a third CPU that is neither end of the pair */
+        int helper = -1;
+        for (int i = 0; i < n && helper < 0; i++)
+            if (cpus[i] != src && cpus[i] != dst[p]) helper = cpus[i];
+
+        struct mesi_result res;
+        if (probe_mesi_latency(src, dst[p], helper, &res) != 0) {
+            printf("%5d  could not pin threads\n", dst[p]);
+            continue;
+        }
+        printf("%5d", dst[p]);
+        for (int s = 0; s < NUM_STATES; s++) {
+            if (res.load_ns[s] < 0) printf(" %7s", "-");
+            else printf(" %7.1f", res.load_ns[s]);
+        }
+        for (int s = 0; s < NUM_STATES; s++) {
+            if (res.store_ns[s] < 0) printf(" %7s", "-");
+            else printf(" %7.1f", res.store_ns[s]);
+        }
+        printf("\n");
+    }
+}
+
+#define FS_SPACINGS 6
+#define FS_MAX_COUNTS 16
+#define FS_INCREMENTS (1 << 21)
+
+static const int fs_spacings[FS_SPACINGS] = { 8, 16, 32, 64, 128, 256 };
+
+struct fs_worker {
+    pthread_t thread;
+    int cpu;
+    volatile uint64_t *counter;
+    volatile int *ready;
+    volatile int *go;
+};
+
+static void *fs_thread(void *arg) {
+    struct fs_worker *w = (struct fs_worker *)arg;
+    pin_to_cpu(w->cpu);
+    __atomic_fetch_add(w->ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) cpu_relax();
+
+    volatile uint64_t *c = w->counter;
+    for (int i = 0; i < FS_INCREMENTS; i++) (*c)++;
+    return NULL;
+}
+
+/*
+ * Run `threads` pinned workers, each incrementing its own counter placed
+ * `spacing` bytes after the previous one. Returns per-thread Mops/s.
+ */
+static double time_false_sharing(const int *cpus, int threads, int spacing) {
+    char *buf = (char *)aligned_alloc(4096, (size_t)threads * 256 + 4096);
+    struct fs_worker *w = (struct fs_worker *)malloc(threads * sizeof(*w));
+    if (!buf || !w) {
+        free(buf);
+        free(w);
+        return 0.0;
+    }
+    memset(buf, 0, (size_t)threads * 256 + 4096);
+
+    volatile int ready = 0, go = 0;
+    for (int t = 0; t < threads; t++) {
+        w[t].cpu = cpus[t];
+        w[t].counter = (volatile uint64_t *)(buf + (size_t)t * spacing);
+        w[t].ready = &ready;
+        w[t].go = &go;
+        if (pthread_create(&w[t].thread, NULL, fs_thread, &w[t]) != 0) {
+            /* Release the ones already waiting; they just run their increments */
+            __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+            for (int i = 0; i < t; i++) pthread_join(w[i].thread, NULL);
+            free(buf);
+            free(w);
+            return 0.0;
+        }
+    }
+    while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) < threads) cpu_relax();
+
+    uint64_t start = get_time();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < threads; t++) pthread_join(w[t].thread, NULL);
+    uint64_t end = get_time();
+
+    double ns = (double)(end - start) / ticks_per_ns;
+    free(buf);
+    free(w);
+    return (double)FS_INCREMENTS / ns * 1e3;
+}
+
+struct false_sharing {
+    int num_counts;
+    int counts[FS_MAX_COUNTS];
+    double mops[FS_SPACINGS][FS_MAX_COUNTS];   /* per-thread Mops/s */
+    int collapse[FS_MAX_COUNTS];    /* largest spacing below 50% of padded, 0 if none */
+    int min_padding;                /* smallest spacing within 90% of padded everywhere */
+};
+
+/*
+ * False-sharing sweep: 2, 4, 8, ... and N threads, counters 8..256 bytes
+ * apart, best of 3 runs. The 256-byte run is the unshared reference; a
+ * spacing is safe when it and every wider one keep at least 90% of its
+ * per-thread rate.
+ */
+int probe_false_sharing(const int *cpus, int n, struct false_sharing *fs) {
+    memset(fs, 0, sizeof(*fs));
+    int max_threads = n < 2 ? 2 : n;
+    for (int t = 2; fs->num_counts < FS_MAX_COUNTS; t *= 2) {
+        if (t >= max_threads) {
+            fs->counts[fs->num_counts++] = max_threads;
+            break;
+        }
+        fs->counts[fs->num_counts++] = t;
+    }
+
+    /* Workers beyond the allowed set wrap around onto shared CPUs */
+    int *worker_cpus = (int *)malloc(max_threads * sizeof(int));
+    if (!worker_cpus) return -1;
+    for (int t = 0; t < max_threads; t++) worker_cpus[t] = cpus[t % n];
+
+    for (int c = 0; c < fs->num_counts; c++)
+        for (int s = 0; s < FS_SPACINGS; s++)
+            for (int rep = 0; rep < 3; rep++) {
+                double mops = time_false_sharing(worker_cpus, fs->counts[c], fs_spacings[s]);
+                if (mops > fs->mops[s][c]) fs->mops[s][c] = mops;
+            }
+    free(worker_cpus);
+
+    fs->min_padding = fs_spacings[FS_SPACINGS - 1];
+    for (int s = FS_SPACINGS - 1; s >= 0; s--) {
+        int ok = 1;
+        for (int c = 0; c < fs->num_counts; c++)
+            if (fs->mops[s][c] < 0.9 * fs->mops[FS_SPACINGS - 1][c]) ok = 0;
+        if (!ok) break;
+        fs->min_padding = fs_spacings[s];
+    }
+
+    for (int c = 0; c < fs->num_counts; c++)
+        for (int s = 0; s < FS_SPACINGS; s++)
+            if (fs->mops[s][c] < 0.5 * fs->mops[FS_SPACINGS - 1][c])
+                fs->collapse[c] = fs_spacings[s];
+    return 0;
+}
+
+static void run_false_sharing(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+
+    printf("=== False sharing: per-thread increments (Mops/s) ===\n");
+    if (n < 2) printf("Only one CPU available; threads time-share and no collapse is expected.\n");
+
+    int line_size = probe_cache_line_size();
+    struct false_sharing fs;
+    if (probe_false_sharing(cpus, n, &fs) != 0) return;
+
+    printf("%8s", "spacing");
+    for (int c = 0; c < fs.num_counts; c++) printf(" %5d thr", fs.counts[c]);
+    printf("\n");
+    for (int s = 0; s < FS_SPACINGS; s++) {
+        printf("%6d B", fs_spacings[s]);
+        for (int c = 0; c < fs.num_counts; c++) printf(" %9.1f", fs.mops[s][c]);
+        printf("\n");
+    }
+
+    printf("\n");
+    for (int c = 0; c < fs.num_counts; c++) {
+        if (fs.collapse[c])
+            printf("%d threads: throughput collapses at %d B spacing and below\n",
+                   fs.counts[c], fs.collapse[c]);
+        else
+            printf("%d threads: no collapse\n", fs.counts[c]);
+    }
+
+    printf("\nMinimum padding: %d bytes (probe_cache_line_size: %d bytes)\n",
+           fs.min_padding, line_size);
+    if (n < 2)
+        printf("(not meaningful without a second CPU)\n");
+    else if (fs.min_padding > line_size)
+        printf("Padding must exceed one line; adjacent-line prefetch likely pairs lines.\n");
+    else if (fs.min_padding < line_size)
+        printf("Coherence granule is below the detected line size.\n");
+}
+
+enum atomic_op { OP_PLAIN, OP_XADD, OP_CAS, OP_XCHG, OP_LLSC, NUM_ATOMIC_OPS };
+
+/* What each op compiles to; NULL where the architecture has no such form */
+#if defined(__x86_64__) || defined(__i386__)
+static const char *atomic_op_names[NUM_ATOMIC_OPS] =
+    { "plain add", "lock xadd", "lock cmpxchg", "xchg", NULL };
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_ATOMICS)
+static const char *atomic_op_names[NUM_ATOMIC_OPS] =
+    { "plain add", "ldaddal (LSE)", "casal (LSE)", "swpal (LSE)", "ldaxr/stlxr" };
+#elif defined(__aarch64__)
+static const char *atomic_op_names[NUM_ATOMIC_OPS] =
+    { "plain add", "fetch_add", "compare_exchange", "exchange", "ldaxr/stlxr" };
+#else
+static const char *atomic_op_names[NUM_ATOMIC_OPS] =
+    { "plain add", "fetch_add", "compare_exchange", "exchange", NULL };
+#endif
+
+/*
+ * Apply one op to *p and return the old value. CAS is a full increment:
+ * it retries from the value a failed exchange returns, so every counted
+ * op is a successful update, as with XADD and XCHG. Without LSE the
+ * aarch64 builtins are outline atomics, which choose LSE or LL/SC at run
+ * time; OP_LLSC always uses an exclusive-load/store loop.
+ */
+static inline uint64_t atomic_apply(int op, volatile uint64_t *p, uint64_t v) {
+    switch (op) {
+    case OP_XADD:
+        return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+    case OP_CAS: {
+        uint64_t old = *p;
+        while (!__atomic_compare_exchange_n(p, &old, old + v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            ;
+        return old;
+    }
+    case OP_XCHG:
+        return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+#if defined(__aarch64__)
+    case OP_LLSC: {
+        uint64_t old, tmp;
+        uint32_t fail;
+        __asm__ __volatile__ (
+            "1: ldaxr %0, [%3]\n"
+            "   add %1, %0, %4\n"
+            "   stlxr %w2, %1, [%3]\n"
+            "   cbnz %w2, 1b\n"
+            : "=&r"(old), "=&r"(tmp), "=&r"(fail) : "r"(p), "r"(v) : "memory");
+        return old;
+    }
+#endif
+    default: {
+        uint64_t old = *p;
+        *p = old + v;
+        return old;
+    }
+    }
+}
+
+#define ATOMIC_CHAIN (1 << 16)
+
+/*
+ * Uncontended latency on a line already in this core's L1. Each operand
+ * depends on the previous result, so ops cannot overlap. Best of 5, ns.
+ */
+static double time_atomic_l1(int op) {
+    static struct shared_line line;
+    double best = -1.0;
+    uint64_t v = 0;
+    for (int rep = 0; rep < 5; rep++) {
+        memory_barrier();
+        uint64_t start = get_time();
+        for (int i = 0; i < ATOMIC_CHAIN; i++)
+            v = atomic_apply(op, &line.value, (v >> 63) + 1);
+        memory_barrier();
+        uint64_t end = get_time();
+        double ns = (double)(end - start) / ticks_per_ns / ATOMIC_CHAIN;
+        if (best < 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+/* One dependent op per probe line, ns per line */
+static double time_line_atomics(char *buf, int op) {
+    uint64_t v = 0;
+    memory_barrier();
+    uint64_t start = get_time();
+    for (int i = 0; i < MESI_LINES; i++)
+        v = atomic_apply(op, (volatile uint64_t *)(buf + i * MESI_STRIDE) + 1, (v >> 63) + 1);
+    memory_barrier();
+    uint64_t end = get_time();
+    return (double)(end - start) / ticks_per_ns / MESI_LINES;
+}
+
+/*
+ * Latency of each op from `dst` on lines just written (Modified) by
+ * `owner`. Median over MESI_TRIALS; ns[op] is -1 for unsupported ops.
+ * Returns -1 if the threads could not be pinned.
+ */
+int probe_atomic_remote(int owner, int dst, double *ns) {
+    for (int op = 0; op < NUM_ATOMIC_OPS; op++) ns[op] = -1.0;
+    if (pin_to_cpu(dst) != 0) return -1;
+
+    char *buf = (char *)aligned_alloc(4096, MESI_LINES * MESI_STRIDE);
+    if (!buf) return -1;
+    memset(buf, 0, MESI_LINES * MESI_STRIDE);
+
+    struct agent source;
+    if (start_agent(&source, owner, buf) != 0) {
+        free(buf);
+        return -1;
+    }
+
+    double samples[MESI_TRIALS];
+    for (int op = 0; op < NUM_ATOMIC_OPS; op++) {
+        if (!atomic_op_names[op]) continue;
+        for (int t = 0; t < MESI_TRIALS; t++) {
+            agent_do(&source, CMD_WRITE);
+            samples[t] = time_line_atomics(buf, op);
+        }
+        qsort(samples, MESI_TRIALS, sizeof(double), compare_double);
+        ns[op] = samples[MESI_TRIALS / 2];
+    }
+
+    stop_agent(&source);
+    free(buf);
+    return 0;
+}
+
+enum placement { PLACE_COMPACT, PLACE_SCATTER, PLACE_SMT, NUM_PLACEMENTS };
+static const char *placement_names[NUM_PLACEMENTS] = { "compact", "scatter", "smt" };
+
+struct placed_cpu {
+    int cpu;
+    int key[3];
+};
+
+static int compare_placed(const void *a, const void *b) {
+    const struct placed_cpu *x = (const struct placed_cpu *)a, *y = (const struct placed_cpu *)b;
+    for (int k = 0; k < 3; k++)
+        if (x->key[k] != y->key[k]) return x->key[k] - y->key[k];
+    return x->cpu - y->cpu;
+}
+
+/*
+ * Sort keys, most significant first, as cache_info's scaling probe uses:
+ *   compact  package, thread, core  - one thread per core, filling a package
+ *   scatter  thread, core, package  - alternate packages, one per core
+ *   smt      package, core, thread  - both siblings of a core before the next
+ */
+static void order_cpus(const int *cpus, int n, int policy, int *order) {
+    static const int keys[NUM_PLACEMENTS][3] = { {0, 2, 1}, {2, 1, 0}, {0, 1, 2} };
+    struct placed_cpu *pc = (struct placed_cpu *)malloc(n * sizeof(*pc));
+    struct cpu_topology *t = (struct cpu_topology *)malloc(sizeof(*t));
+    if (!pc || !t) {
+        memcpy(order, cpus, n * sizeof(int));
+        free(pc);
+        free(t);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        read_cpu_topology(cpus[i], t);
+        int fields[3] = { t->package, t->core, t->thread };
+        pc[i].cpu = cpus[i];
+        for (int k = 0; k < 3; k++) pc[i].key[k] = fields[keys[policy][k]];
+    }
+    qsort(pc, n, sizeof(*pc), compare_placed);
+    for (int i = 0; i < n; i++) order[i] = pc[i].cpu;
+    free(pc);
+    free(t);
+}
+
+struct atomic_worker {
+    pthread_t thread;
+    int cpu;
+    int op;
+    volatile uint64_t *target;
+    volatile int *ready;
+    volatile int *go;
+    volatile int *stop;
+    uint64_t ops;
+} __attribute__((aligned(128)));
+
+static void *atomic_thread(void *arg) {
+    struct atomic_worker *w = (struct atomic_worker *)arg;
+    pin_to_cpu(w->cpu);
+    __atomic_fetch_add(w->ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) cpu_relax();
+
+    uint64_t ops = 0;
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < 64; i++) atomic_apply(w->op, w->target, 1);
+        ops += 64;
+    }
+    w->ops = ops;
+    return NULL;
+}
+
+/* Aggregate ops/s of `threads` workers hammering one line for ~50ms */
+static double time_atomic_contention(const int *cpus, int threads, int op) {
+    static struct shared_line line;
+    struct atomic_worker *w = (struct atomic_worker *)aligned_alloc(128, threads * sizeof(*w));
+    if (!w) return 0.0;
+    memset(w, 0, threads * sizeof(*w));
+
+    volatile int ready = 0, go = 0, stop = 0;
+    for (int t = 0; t < threads; t++) {
+        w[t].cpu = cpus[t];
+        w[t].op = op;
+        w[t].target = &line.value;
+        w[t].ready = &ready;
+        w[t].go = &go;
+        w[t].stop = &stop;
+        if (pthread_create(&w[t].thread, NULL, atomic_thread, &w[t]) != 0) {
+            /* Release the ones already waiting; they stop straight away */
+            __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+            for (int i = 0; i < t; i++) pthread_join(w[i].thread, NULL);
+            free(w);
+            return 0.0;
+        }
+    }
+    while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) < threads) cpu_relax();
+
+    struct timespec window = { 0, 50 * 1000 * 1000 }, t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    nanosleep(&window, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    uint64_t ops = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(w[t].thread, NULL);
+        ops += w[t].ops;
+    }
+    free(w);
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    return (double)ops / secs;
+}
+
+static void run_atomics(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    int self = cpus[0];
+    pin_to_cpu(self);
+
+    int owner[NUM_PAIRS];
+    pick_pair_cpus(cpus, n, self, owner);
+    double remote[NUM_PAIRS][NUM_ATOMIC_OPS];
+    for (int p = 0; p < NUM_PAIRS; p++) {
+        for (int op = 0; op < NUM_ATOMIC_OPS; op++) remote[p][op] = -1.0;
+        if (owner[p] >= 0) probe_atomic_remote(owner[p], self, remote[p]);
+    }
+    pin_to_cpu(self);
+
+    printf("=== Uncontended atomic latency (ns per op) on CPU %d ===\n", self);
+    printf("Remote columns: line last written by that CPU (Modified there)\n");
+    printf("%-18s %8s", "op", "L1 hit");
+    for (int p = 0; p < NUM_PAIRS; p++) printf(" %13s", pair_names[p]);
+    printf("\n");
+    for (int op = 0; op < NUM_ATOMIC_OPS; op++) {
+        if (!atomic_op_names[op]) continue;
+        printf("%-18s %8.1f", atomic_op_names[op], time_atomic_l1(op));
+        for (int p = 0; p < NUM_PAIRS; p++) {
+            if (remote[p][op] < 0) printf(" %13s", "-");
+            else printf(" %13.1f", remote[p][op]);
+        }
+        printf("\n");
+    }
+
+    int counts[32], num_counts = 0;
+    for (int t = 1; num_counts < 31; t *= 2) {
+        if (t >= n) break;
+        counts[num_counts++] = t;
+    }
+    counts[num_counts++] = n;
+
+    printf("\n=== Contended atomics on one shared line ===\n");
+    printf("ns/op is the average time each thread waits per op\n");
+    printf("%-18s %-9s %7s %10s %9s\n", "op", "placement", "threads", "Mops/s", "ns/op");
+    int order[MAX_CPUS], prev[NUM_PLACEMENTS][MAX_CPUS];
+    for (int op = OP_XADD; op < NUM_ATOMIC_OPS; op++) {
+        if (!atomic_op_names[op]) continue;
+        for (int policy = 0; policy < NUM_PLACEMENTS; policy++) {
+            order_cpus(cpus, n, policy, order);
+            memcpy(prev[policy], order, n * sizeof(int));
+            /* Without SMT or a second package some orders coincide */
+            int same = 0;
+            for (int p = 0; p < policy && !same; p++)
+                same = memcmp(order, prev[p], n * sizeof(int)) == 0;
+            if (same) continue;
+
+            for (int c = 0; c < num_counts; c++) {
+                double rate = time_atomic_contention(order, counts[c], op);
+                printf("%-18s %-9s %7d %10.1f %9.1f\n", atomic_op_names[op],
+                       placement_names[policy], counts[c], rate / 1e6,
+                       rate > 0 ? counts[c] / rate * 1e9 : 0.0);
+            }
+        }
+    }
+}
+
+/* Misaligned and split accesses */
+#define SPLIT_OPS (1 << 16)
+#define SPLIT_BATCH 256
+#define SPLIT_BUDGET_NS 200e6       /* trapped split locks can take ms each */
+
+typedef uint64_t unaligned_u64 __attribute__((aligned(1)));
+
+enum access_kind { ACC_LOAD, ACC_STORE, ACC_ATOMIC, NUM_ACCESSES };
+static const char *access_names[NUM_ACCESSES] = { "load", "store", "atomic add" };
+
+enum split_kind { SPLIT_NONE, SPLIT_MISALIGNED, SPLIT_LINE, SPLIT_PAGE, NUM_SPLITS };
+static const char *split_names[NUM_SPLITS] = { "aligned", "misaligned", "line split", "page split" };
+
+/* Offset of the 8-byte operand in a two-page buffer */
+static size_t split_offset(int kind, int line_size) {
+    switch (kind) {
+    case SPLIT_MISALIGNED: return (size_t)line_size + 1;        /* inside one line */
+    case SPLIT_LINE:       return 2 * (size_t)line_size - 4;
+    case SPLIT_PAGE:       return 4096 - 4;
+    default:               return (size_t)line_size;
+    }
+}
+
+static sigjmp_buf split_trap;
+
+static void split_trap_handler(int sig) {
+    (void)sig;
+    siglongjmp(split_trap, 1);
+}
+
+/*
+ * ns per access at p. Loads are a dependent chain (latency), stores and
+ * atomics back to back. Stops after SPLIT_BUDGET_NS so a throttled split
+ * lock cannot stall the run. Returns -1 if the access raised SIGBUS.
+ */
+static double time_split_access(char *p, int kind) {
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = split_trap_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, &old);
+    if (sigsetjmp(split_trap, 1)) {
+        sigaction(SIGBUS, &old, NULL);
+        return -1.0;
+    }
+
+    uint64_t v = 0, done = 0;
+    uint64_t budget = (uint64_t)(SPLIT_BUDGET_NS * ticks_per_ns);
+    memory_barrier();
+    uint64_t start = get_time();
+    while (done < SPLIT_OPS) {
+        switch (kind) {
+        case ACC_LOAD:
+            for (int i = 0; i < SPLIT_BATCH; i++)
+                v = *(volatile unaligned_u64 *)(p + (v >> 63));
+            break;
+        case ACC_STORE:
+            for (int i = 0; i < SPLIT_BATCH; i++)
+                *(volatile unaligned_u64 *)p = v++;
+            break;
+        default:
+            /* Deliberately misaligned: this is the split lock under test */
+            for (int i = 0; i < SPLIT_BATCH; i++)
+                __atomic_fetch_add((uint64_t *)p, 1, __ATOMIC_SEQ_CST);
+            break;
+        }
+        done += SPLIT_BATCH;
+        if (get_time() - start > budget) break;
+    }
+    memory_barrier();
+    uint64_t end = get_time();
+
+    sigaction(SIGBUS, &old, NULL);
+    return (double)(end - start) / ticks_per_ns / done;
+}
+
+/* Whole-word match of `flag` in a /proc/cpuinfo flags line */
+static int has_cpu_flag(const char *line, const char *flag) {
+    size_t len = strlen(flag);
+    for (const char *s = strstr(line, flag); s; s = strstr(s + 1, flag))
+        if (s[-1] == ' ' && (s[len] == ' ' || s[len] == '\n' || s[len] == '\0')) return 1;
+    return 0;
+}
+
+/* Report how the kernel handles split locks */
+static void report_split_lock_detect(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    int sld = 0, bld = 0;
+    char line[8192];
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "flags", 5) != 0) continue;
+            sld = has_cpu_flag(line, "split_lock_detect");
+            bld = has_cpu_flag(line, "bus_lock_detect");
+            break;
+        }
+        fclose(f);
+    }
+
+    /* Kernel default is warn when the CPU can trap split locks */
+    char mode[64] = "warn";
+    if (read_sys_string("/proc/cmdline", line, sizeof(line)) == 0) {
+        const char *s = strstr(line, "split_lock_detect=");
+        if (s) sscanf(s + strlen("split_lock_detect="), "%63s", mode);
+    }
+    char mitigate[32];
+    if (read_sys_string("/proc/sys/kernel/split_lock_mitigate", mitigate, sizeof(mitigate)) != 0)
+        strcpy(mitigate, "n/a");
+
+    printf("split_lock_detect: %s", sld ? "supported" : "not supported");
+    if (bld) printf(", bus_lock_detect supported");
+    printf("\n");
+    if (!sld && !bld) {
+        printf("Split locks are not trapped; they take a bus lock silently\n");
+        return;
+    }
+    printf("Kernel mode: %s, split_lock_mitigate: %s\n", mode, mitigate);
+    if (strcmp(mode, "off") == 0) return;
+    if (strcmp(mode, "fatal") == 0)
+        printf("Split locks raise SIGBUS\n");
+    else if (strncmp(mode, "ratelimit", 9) == 0)
+        printf("Bus locks are rate-limited per second system-wide\n");
+    else if (strcmp(mitigate, "1") == 0)
+        printf("Split locks are logged and the offending task is throttled\n");
+    else
+        printf("Split locks are logged\n");
+#else
+    printf("split_lock_detect: x86 only\n");
+    printf("Unaligned atomics are expected to raise an alignment fault (SIGBUS)\n");
+#endif
+}
+
+#define VICTIM_CHUNK 4096
+
+/* Largest cache the OS reports, for sizing DRAM working sets */
+static size_t last_level_cache_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 32 * 1024 * 1024;
+}
+
+static size_t physical_memory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (size_t)pages * page_size;
+    return (size_t)4 * 1024 * 1024 * 1024;
+}
+
+struct victim {
+    pthread_t thread;
+    int cpu;
+    char *buf;
+    size_t bytes;
+    volatile uint64_t chunks;       /* VICTIM_CHUNK blocks read so far */
+    volatile int ready;             /* buffer first-touched */
+    volatile int stop;
+    uint64_t sink;
+} __attribute__((aligned(128)));
+
+/* Streams its own buffer, larger than the LLC, and counts progress */
+static void *victim_thread(void *arg) {
+    struct victim *v = (struct victim *)arg;
+    pin_to_cpu(v->cpu);
+    memset(v->buf, 1, v->bytes);
+    __atomic_store_n(&v->ready, 1, __ATOMIC_RELEASE);
+
+    uint64_t sum = 0, chunks = 0;
+    size_t pos = 0;
+    while (!__atomic_load_n(&v->stop, __ATOMIC_RELAXED)) {
+        const uint64_t *p = (const uint64_t *)(v->buf + pos);
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (size_t i = 0; i < VICTIM_CHUNK / 8; i += 4) {
+            s0 += p[i]; s1 += p[i + 1]; s2 += p[i + 2]; s3 += p[i + 3];
+        }
+        sum += s0 + s1 + s2 + s3;
+        pos = (pos + VICTIM_CHUNK) % v->bytes;
+        __atomic_store_n(&v->chunks, ++chunks, __ATOMIC_RELAXED);
+    }
+    v->sink = sum;
+    return NULL;
+}
+
+enum storm_phase { STORM_IDLE, STORM_ALIGNED, STORM_SPLIT, STORM_QUIT, NUM_STORM_PHASES };
+static const char *storm_names[STORM_QUIT] = { "idle", "aligned lock", "split lock" };
+
+struct storm {
+    pthread_t thread;
+    int cpu;
+    char *aligned;
+    char *split;
+    volatile int phase;
+    volatile uint64_t ops;
+};
+
+static void *storm_thread(void *arg) {
+    struct storm *s = (struct storm *)arg;
+    pin_to_cpu(s->cpu);
+    uint64_t ops = 0;
+    for (;;) {
+        int phase = __atomic_load_n(&s->phase, __ATOMIC_RELAXED);
+        if (phase == STORM_QUIT) break;
+        if (phase == STORM_IDLE) {
+            cpu_relax();
+            continue;
+        }
+        char *p = phase == STORM_SPLIT ? s->split : s->aligned;
+        for (int i = 0; i < 64; i++)
+            __atomic_fetch_add((uint64_t *)p, 1, __ATOMIC_SEQ_CST);
+        ops += 64;
+        __atomic_store_n(&s->ops, ops, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/*
+ * One aggressor on cpus[0] runs aligned, then split, locked adds while
+ * every other allowed CPU streams memory. Prints each victim's MB/s per
+ * phase and how many slowed by more than 10% under split locks.
+ */
+static void probe_split_lock_victims(const int *cpus, int n, char *aligned, char *split) {
+    int nv = n - 1;
+    struct victim *v = (struct victim *)aligned_alloc(128, nv * sizeof(*v));
+    double *rate = (double *)calloc((size_t)nv * STORM_QUIT, sizeof(double));
+    if (!v || !rate) {
+        free(v);
+        free(rate);
+        return;
+    }
+    memset(v, 0, nv * sizeof(*v));
+
+    /* Twice the LLC each, so victims stream from DRAM; all of them within a quarter of RAM */
+    size_t bytes = 2 * last_level_cache_size();
+    if (bytes * nv > physical_memory() / 4) bytes = physical_memory() / 4 / nv;
+    bytes = bytes / VICTIM_CHUNK * VICTIM_CHUNK;
+
+    int started = 0;
+    for (int i = 0; i < nv; i++) {
+        v[i].cpu = cpus[i + 1];
+        v[i].bytes = bytes;
+        v[i].buf = (char *)malloc(bytes);
+        if (!v[i].buf) break;
+        if (pthread_create(&v[i].thread, NULL, victim_thread, &v[i]) != 0) {
+            free(v[i].buf);
+            break;
+        }
+        started++;
+    }
+
+    struct storm s;
+    memset(&s, 0, sizeof(s));
+    s.cpu = cpus[0];
+    s.aligned = aligned;
+    s.split = split;
+    s.phase = STORM_IDLE;
+    if (pthread_create(&s.thread, NULL, storm_thread, &s) != 0) {
+        printf("Could not start the aggressor thread.\n");
+        for (int i = 0; i < started; i++) {
+            v[i].stop = 1;
+            pthread_join(v[i].thread, NULL);
+            free(v[i].buf);
+        }
+        free(v);
+        free(rate);
+        return;
+    }
+
+    /* Let victims finish first-touch before measuring */
+    for (int i = 0; i < started; i++)
+        while (!__atomic_load_n(&v[i].ready, __ATOMIC_ACQUIRE)) cpu_relax();
+    struct timespec window = { 0, 100 * 1000 * 1000 };
+
+    double storm_mops[STORM_QUIT];
+    for (int phase = 0; phase < STORM_QUIT; phase++) {
+        __atomic_store_n(&s.phase, phase, __ATOMIC_RELAXED);
+        nanosleep(&window, NULL);
+        uint64_t before_ops = s.ops;
+        uint64_t *before = (uint64_t *)malloc(started * sizeof(uint64_t));
+        if (!before) break;
+        for (int i = 0; i < started; i++) before[i] = v[i].chunks;
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        nanosleep(&window, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        for (int i = 0; i < started; i++)
+            rate[i * STORM_QUIT + phase] =
+                (double)(v[i].chunks - before[i]) * VICTIM_CHUNK / secs / 1e6;
+        storm_mops[phase] = (double)(s.ops - before_ops) / secs / 1e6;
+        free(before);
+    }
+
+    __atomic_store_n(&s.phase, STORM_QUIT, __ATOMIC_RELAXED);
+    pthread_join(s.thread, NULL);
+    for (int i = 0; i < started; i++) {
+        v[i].stop = 1;
+        pthread_join(v[i].thread, NULL);
+        free(v[i].buf);
+    }
+
+    printf("Aggressor on CPU %d: %.1f Mops/s aligned, %.3f Mops/s split\n",
+           cpus[0], storm_mops[STORM_ALIGNED], storm_mops[STORM_SPLIT]);
+    printf("%6s", "victim");
+    for (int phase = 0; phase < STORM_QUIT; phase++) printf(" %12s", storm_names[phase]);
+    printf(" %9s\n", "slowdown");
+    int slowed = 0;
+    for (int i = 0; i < started; i++) {
+        const double *r = &rate[i * STORM_QUIT];
+        double slowdown = r[STORM_IDLE] > 0 ? 1.0 - r[STORM_SPLIT] / r[STORM_IDLE] : 0.0;
+        if (slowdown > 0.1) slowed++;
+        printf("%6d", v[i].cpu);
+        for (int phase = 0; phase < STORM_QUIT; phase++) printf(" %7.0f MB/s", r[phase]);
+        printf(" %8.1f%%\n", slowdown * 100.0);
+    }
+    printf("%d of %d victims slowed by more than 10%% during the split-lock storm\n",
+           slowed, started);
+
+    for (int i = started; i < nv; i++) free(v[i].buf);
+    free(v);
+    free(rate);
+}
+
+static void run_split_lock(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    pin_to_cpu(cpus[0]);
+
+    printf("=== Split-lock detection ===\n");
+    report_split_lock_detect();
+
+    int line_size = probe_cache_line_size();
+    char *buf = (char *)aligned_alloc(4096, 2 * 4096);
+    if (!buf) return;
+
+    printf("\n=== Misaligned access cost on CPU %d (ns per 8-byte access) ===\n", cpus[0]);
+    printf("Line size %d B; loads are a dependent chain, stores and atomics back to back\n",
+           line_size);
+    printf("%-11s", "access");
+    for (int s = 0; s < NUM_SPLITS; s++) printf(" %12s", split_names[s]);
+    printf("\n");
+
+    int split_atomic_ok = 0;
+    for (int a = 0; a < NUM_ACCESSES; a++) {
+        printf("%-11s", access_names[a]);
+        double base = 0.0;
+        for (int s = 0; s < NUM_SPLITS; s++) {
+            memset(buf, 0, 2 * 4096);
+            double ns = time_split_access(buf + split_offset(s, line_size), a);
+            if (s == SPLIT_NONE) base = ns;
+            if (ns < 0) {
+                printf(" %12s", "SIGBUS");
+            } else if (s == SPLIT_NONE || base <= 0) {
+                printf(" %12.2f", ns);
+            } else {
+                char cell[32];
+                snprintf(cell, sizeof(cell), "%.2f x%.1f", ns, ns / base);
+                printf(" %12s", cell);
+            }
+            if (a == ACC_ATOMIC && s == SPLIT_LINE && ns >= 0) split_atomic_ok = 1;
+        }
+        printf("\n");
+    }
+
+    printf("\n=== Cross-core victims of a split-lock storm ===\n");
+    if (n < 2)
+        printf("Only one CPU available; no victims to measure.\n");
+    else if (!split_atomic_ok)
+        printf("Split atomics fault on this system; storm skipped.\n");
+    else
+        probe_split_lock_victims(cpus, n, buf + split_offset(SPLIT_NONE, line_size),
+                                 buf + split_offset(SPLIT_LINE, line_size));
+    free(buf);
+}
+
+int main(int argc, char **argv) {
+#ifndef __linux__
+    printf("CPU pinning requires Linux (sched_setaffinity).\n");
+#endif
+    calibrate_timer();
+
+    const char *mode = argc > 1 ? argv[1] : "matrix";
+    if (strcmp(mode, "matrix") == 0) {
+        run_matrix(argc, argv);
+    } else if (strcmp(mode, "mesi") == 0) {
+        run_mesi();
+    } else if (strcmp(mode, "falseshare") == 0) {
+        run_false_sharing();
+    } else if (strcmp(mode, "atomic") == 0) {
+        run_atomics();
+    } else if (strcmp(mode, "splitlock") == 0) {
+        run_split_lock();
+    } else {
+        printf("Usage: %s [matrix [parallel] [file] | mesi | falseshare | atomic | splitlock]\n",
+               argv[0]);
+        return 1;
+    }
+    return 0;
+}
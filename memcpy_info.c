@@ -0,0 +1,574 @@
+/*
+ * Memory Copy Strategy Benchmark
+ * Compares copy routines at sizes bracketing the measured cache levels
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/* High-resolution timing */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t get_time(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t get_time(void) {
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+static inline uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline void memory_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("mfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("dmb sy" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+static double ticks_per_ns = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+/* Pin to the first allowed CPU so every size runs on the same caches */
+static int pin_to_first_cpu(void) {
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return -1;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &set)) continue;
+        CPU_ZERO(&set);
+        CPU_SET(c, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0 ? c : -1;
+    }
+#endif
+    return -1;
+}
+
+/* Sattolo's shuffle: one random cycle through every element */
+static void create_pointer_chase(size_t *array, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        array[i] = i;
+    }
+
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % i;
+        size_t temp = array[i];
+        array[i] = array[j];
+        array[j] = temp;
+    }
+}
+
+/* Detect cache sizes via pointer-chase, as cache_info does */
+void probe_cache_sizes(size_t *l1_size, size_t *l2_size, size_t *l3_size) {
+    const int ITERATIONS = 5;
+
+    size_t sizes[] = {
+        4*1024, 8*1024, 16*1024, 32*1024, 48*1024, 64*1024, 96*1024, 128*1024,
+        192*1024, 256*1024, 384*1024, 512*1024, 768*1024, 1024*1024, 1536*1024,
+        2*1024*1024, 3*1024*1024, 4*1024*1024, 6*1024*1024, 8*1024*1024,
+        12*1024*1024, 16*1024*1024, 24*1024*1024, 32*1024*1024,
+        48*1024*1024, 64*1024*1024
+    };
+    int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    double times[32];
+
+    srand(12345);
+
+    for (int s = 0; s < num_sizes; s++) {
+        size_t size = sizes[s];
+        size_t count = size / sizeof(size_t);
+        size_t accesses = count * 4;
+
+        size_t *array = (size_t *)malloc(size);
+        if (!array) break;
+
+        create_pointer_chase(array, count);
+
+        size_t idx = 0;
+        for (size_t i = 0; i < count; i++) {
+            idx = array[idx];
+        }
+
+        uint64_t total_time = 0;
+        for (int iter = 0; iter < ITERATIONS; iter++) {
+            idx = 0;
+            memory_barrier();
+            uint64_t start = get_time();
+            memory_barrier();
+
+            for (size_t a = 0; a < accesses; a++) {
+                idx = array[idx];
+            }
+
+            memory_barrier();
+            uint64_t end = get_time();
+            total_time += (end - start);
+        }
+
+        volatile size_t dummy = idx;
+        (void)dummy;
+
+        times[s] = (double)total_time / (ITERATIONS * accesses);
+        free(array);
+    }
+
+    *l1_size = 0;
+    *l2_size = 0;
+    *l3_size = 0;
+
+    for (int s = 1; s < num_sizes; s++) {
+        double ratio = times[s] / times[s-1];
+        if (*l1_size == 0 && sizes[s-1] <= 192*1024 && ratio > 1.3) {
+            *l1_size = sizes[s-1];
+        } else if (*l2_size == 0 && sizes[s-1] > 192*1024 && sizes[s-1] <= 16*1024*1024 && ratio > 1.3) {
+            *l2_size = sizes[s-1];
+        } else if (*l3_size == 0 && sizes[s-1] > 4*1024*1024 && ratio > 1.5) {
+            *l3_size = sizes[s-1];
+        }
+    }
+}
+
+/* Data cache sizes the OS reports per level, 0 where unknown */
+static void os_cache_sizes(size_t *levels) {
+    long size[3] = { -1, -1, -1 };
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    size[0] = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    size[1] = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    size[2] = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    for (int l = 0; l < 3; l++) levels[l] = size[l] > 0 ? (size_t)size[l] : 0;
+}
+
+static size_t physical_memory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (size_t)pages * page_size;
+    return (size_t)4 * 1024 * 1024 * 1024;
+}
+
+typedef void (*copy_fn)(void *dst, const void *src, size_t n);
+
+static void copy_glibc(void *dst, const void *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+/* Under 16 bytes: widest scalar moves that fit, overlapping at the end */
+static inline void copy_small(char *d, const char *s, size_t n) {
+    if (n >= 8) {
+        uint64_t a, b;
+        memcpy(&a, s, 8);
+        memcpy(&b, s + n - 8, 8);
+        memcpy(d, &a, 8);
+        memcpy(d + n - 8, &b, 8);
+    } else if (n >= 4) {
+        uint32_t a, b;
+        memcpy(&a, s, 4);
+        memcpy(&b, s + n - 4, 4);
+        memcpy(d, &a, 4);
+        memcpy(d + n - 4, &b, 4);
+    } else {
+        for (size_t i = 0; i < n; i++) d[i] = s[i];
+    }
+}
+
+#if defined(__x86_64__)
+static void copy_rep_movsb(void *dst, const void *src, size_t n) {
+    __asm__ __volatile__ ("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) :: "memory");
+}
+
+/*
+ * Vector loops: 64 bytes per iteration with unaligned loads and stores,
+ * the remainder in vector steps and the last vector overlapping the end.
+ */
+static void copy_sse2(void *dst, const void *src, size_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    if (n < 16) {
+        copy_small(d, s, n);
+        return;
+    }
+    __m128i last = _mm_loadu_si128((const __m128i *)(s + n - 16));
+    char *end = d + n - 16;
+    for (; n >= 64; n -= 64, s += 64, d += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)s);
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+        _mm_storeu_si128((__m128i *)d, a);
+        _mm_storeu_si128((__m128i *)(d + 16), b);
+        _mm_storeu_si128((__m128i *)(d + 32), c);
+        _mm_storeu_si128((__m128i *)(d + 48), e);
+    }
+    for (; n >= 16; n -= 16, s += 16, d += 16)
+        _mm_storeu_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+    _mm_storeu_si128((__m128i *)end, last);
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(void *dst, const void *src, size_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    if (n < 32) {
+        copy_sse2(d, s, n);
+        return;
+    }
+    __m256i last = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+    char *end = d + n - 32;
+    for (; n >= 128; n -= 128, s += 128, d += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)s);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+        _mm256_storeu_si256((__m256i *)d, a);
+        _mm256_storeu_si256((__m256i *)(d + 32), b);
+        _mm256_storeu_si256((__m256i *)(d + 64), c);
+        _mm256_storeu_si256((__m256i *)(d + 96), e);
+    }
+    for (; n >= 32; n -= 32, s += 32, d += 32)
+        _mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+    _mm256_storeu_si256((__m256i *)end, last);
+    _mm256_zeroupper();
+}
+
+/*
+ * Non-temporal: align the destination to a line, stream whole lines
+ * past the caches, then fence so the copy is visible before returning.
+ */
+static void copy_nt(void *dst, const void *src, size_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    size_t head = (64 - ((uintptr_t)d & 63)) & 63;
+    if (n < head + 64) {
+        copy_sse2(d, s, n);
+        return;
+    }
+    copy_sse2(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    for (; n >= 64; n -= 64, s += 64, d += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)s);
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+        _mm_stream_si128((__m128i *)d, a);
+        _mm_stream_si128((__m128i *)(d + 16), b);
+        _mm_stream_si128((__m128i *)(d + 32), c);
+        _mm_stream_si128((__m128i *)(d + 48), e);
+    }
+    _mm_sfence();
+    copy_sse2(d, s, n);
+}
+
+static int have_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+#elif defined(__aarch64__)
+
+static void copy_neon(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    if (n < 16) {
+        copy_small((char *)d, (const char *)s, n);
+        return;
+    }
+    uint8x16_t last = vld1q_u8(s + n - 16);
+    uint8_t *end = d + n - 16;
+    for (; n >= 64; n -= 64, s += 64, d += 64) {
+        uint8x16_t a = vld1q_u8(s), b = vld1q_u8(s + 16);
+        uint8x16_t c = vld1q_u8(s + 32), e = vld1q_u8(s + 48);
+        vst1q_u8(d, a);
+        vst1q_u8(d + 16, b);
+        vst1q_u8(d + 32, c);
+        vst1q_u8(d + 48, e);
+    }
+    for (; n >= 16; n -= 16, s += 16, d += 16)
+        vst1q_u8(d, vld1q_u8(s));
+    vst1q_u8(end, last);
+}
+
+/* Non-temporal: STNP pairs of q registers for whole lines */
+static void copy_nt(void *dst, const void *src, size_t n) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    size_t head = (64 - ((uintptr_t)d & 63)) & 63;
+    if (n < head + 64) {
+        copy_neon(d, s, n);
+        return;
+    }
+    copy_neon(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    for (; n >= 64; n -= 64, s += 64, d += 64)
+        __asm__ __volatile__ (
+            "ldp q0, q1, [%1]\n\t"
+            "ldp q2, q3, [%1, #32]\n\t"
+            "stnp q0, q1, [%0]\n\t"
+            "stnp q2, q3, [%0, #32]"
+            :: "r"(d), "r"(s) : "v0", "v1", "v2", "v3", "memory");
+    __asm__ __volatile__ ("dmb ishst" ::: "memory");
+    copy_neon(d, s, n);
+}
+#endif
+
+/* Copy strategies; NULL entries are not available on this build */
+enum copy_kind { COPY_GLIBC, COPY_REP_MOVSB, COPY_SIMD, COPY_SIMD_WIDE, COPY_NT, NUM_COPY_KINDS };
+static const char *copy_names[NUM_COPY_KINDS] = { "glibc", "movsb", "simd", "simd-w", "nt" };
+
+static void copy_strategies(copy_fn *fns) {
+    for (int k = 0; k < NUM_COPY_KINDS; k++) fns[k] = NULL;
+    fns[COPY_GLIBC] = copy_glibc;
+#if defined(__x86_64__)
+    fns[COPY_REP_MOVSB] = copy_rep_movsb;
+    fns[COPY_SIMD] = copy_sse2;
+    if (have_avx2()) fns[COPY_SIMD_WIDE] = copy_avx2;
+    fns[COPY_NT] = copy_nt;
+#elif defined(__aarch64__)
+    fns[COPY_SIMD] = copy_neon;
+    fns[COPY_NT] = copy_nt;
+#endif
+}
+
+#define COPY_TRIALS 3
+#define COPY_BYTES_PER_TRIAL (64 * 1024 * 1024)
+
+/*
+ * Bytes per nanosecond (GB/s) copying `n` bytes from `src` to `dst`
+ * repeatedly. The same buffers are reused, so the copy runs from
+ * whichever level holds 2n bytes. Best of COPY_TRIALS.
+ */
+static double time_copy(copy_fn fn, char *dst, const char *src, size_t n) {
+    size_t reps = COPY_BYTES_PER_TRIAL / n;
+    if (reps < 2) reps = 2;
+    fn(dst, src, n);
+    double best = 0;
+    for (int t = 0; t < COPY_TRIALS; t++) {
+        memory_barrier();
+        uint64_t start = get_time();
+        for (size_t r = 0; r < reps; r++)
+            fn(dst, src, n);
+        memory_barrier();
+        uint64_t end = get_time();
+        double rate = (double)n * reps / ((double)(end - start) / ticks_per_ns);
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+#define MAX_COPY_SIZES 64
+#define COPY_MARGIN 1.05
+
+static int compare_size(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Powers of two from 64B to 64MB, plus a quarter, half and all of each
+ * cache level so that the 2n-byte footprint lands on either side of it.
+ * Sizes whose two buffers would take over a quarter of RAM are dropped.
+ */
+static int copy_sizes(const size_t *levels, size_t *sizes) {
+    int n = 0;
+    for (size_t s = 64; s <= 64 * 1024 * 1024; s *= 2) sizes[n++] = s;
+    for (int l = 0; l < 3; l++) {
+        if (levels[l] == 0) continue;
+        sizes[n++] = levels[l] / 4;
+        sizes[n++] = levels[l] / 2;
+        sizes[n++] = levels[l];
+    }
+    qsort(sizes, n, sizeof(size_t), compare_size);
+    size_t limit = physical_memory() / 8;
+    int unique = 0;
+    for (int i = 0; i < n; i++)
+        if (sizes[i] <= limit && (unique == 0 || sizes[i] != sizes[unique - 1]))
+            sizes[unique++] = sizes[i];
+    return unique;
+}
+
+static void format_size(size_t size, char *buf, size_t len) {
+    if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+        snprintf(buf, len, "%zu MB", size / (1024 * 1024));
+    else if (size >= 1024 && size % 1024 == 0)
+        snprintf(buf, len, "%zu KB", size / 1024);
+    else
+        snprintf(buf, len, "%zu B", size);
+}
+
+/* Smallest level holding a 2n-byte footprint */
+static const char *footprint_level(size_t n, const size_t *levels) {
+    static const char *names[] = { "L1", "L2", "L3" };
+    for (int l = 0; l < 3; l++)
+        if (levels[l] && 2 * n <= levels[l]) return names[l];
+    return "mem";
+}
+
+struct copy_sweep {
+    int num_sizes;
+    size_t sizes[MAX_COPY_SIZES];
+    double rate[MAX_COPY_SIZES][NUM_COPY_KINDS];    /* GB/s, 0 if unavailable */
+    int best[MAX_COPY_SIZES];                       /* glibc unless beaten by COPY_MARGIN */
+};
+
+/*
+ * Run every strategy at every size with the given source and destination
+ * offsets from 64-byte alignment. Buffers come from one allocation of the
+ * largest size so smaller copies start at the same addresses.
+ */
+int probe_copy_sweep(const size_t *levels, size_t src_off, size_t dst_off,
+                     struct copy_sweep *cs) {
+    copy_fn fns[NUM_COPY_KINDS];
+    copy_strategies(fns);
+    cs->num_sizes = copy_sizes(levels, cs->sizes);
+    size_t max = cs->sizes[cs->num_sizes - 1];
+
+    char *src = (char *)aligned_alloc(4096, max + 4096);
+    char *dst = (char *)aligned_alloc(4096, max + 4096);
+    if (!src || !dst) {
+        free(src);
+        free(dst);
+        return -1;
+    }
+    memset(src, 0x5a, max + 4096);
+    memset(dst, 0, max + 4096);
+
+    /* Both buffers are page-aligned; shift dst a line so the two don't 4K-alias */
+    char *s = src + src_off;
+    char *d = dst + 64 + dst_off;
+    for (int i = 0; i < cs->num_sizes; i++) {
+        int best = COPY_GLIBC;
+        for (int k = 0; k < NUM_COPY_KINDS; k++) {
+            cs->rate[i][k] = fns[k] ? time_copy(fns[k], d, s, cs->sizes[i]) : 0;
+            if (cs->rate[i][k] > cs->rate[i][best]) best = k;
+        }
+        /* Within run-to-run noise of glibc there is nothing to switch to */
+        cs->best[i] = cs->rate[i][best] > COPY_MARGIN * cs->rate[i][COPY_GLIBC] ? best : COPY_GLIBC;
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
+
+/* Size ranges sharing a fastest strategy: the thresholds a dispatching copy would use */
+static void print_crossovers(const struct copy_sweep *cs) {
+    char lo[32], hi[32];
+    printf("Fastest by size:\n");
+    for (int i = 0; i < cs->num_sizes;) {
+        int b = cs->best[i], j = i;
+        double gain = cs->rate[i][b] / cs->rate[i][COPY_GLIBC];
+        while (j + 1 < cs->num_sizes && cs->best[j + 1] == b) {
+            j++;
+            if (cs->rate[j][b] / cs->rate[j][COPY_GLIBC] > gain)
+                gain = cs->rate[j][b] / cs->rate[j][COPY_GLIBC];
+        }
+        format_size(cs->sizes[i], lo, sizeof(lo));
+        format_size(cs->sizes[j], hi, sizeof(hi));
+        if (b == COPY_GLIBC) printf("  %8s - %-8s %s\n", lo, hi, copy_names[b]);
+        else printf("  %8s - %-8s %-7s up to %.2fx glibc\n", lo, hi, copy_names[b], gain);
+        i = j + 1;
+    }
+}
+
+static void run_copy_sweep(const size_t *levels, size_t src_off, size_t dst_off) {
+    struct copy_sweep cs;
+    printf("\n=== src+%zu, dst+%zu (GB/s) ===\n", src_off, dst_off);
+    if (probe_copy_sweep(levels, src_off, dst_off, &cs) != 0) {
+        printf("Buffer allocation failed.\n");
+        return;
+    }
+    printf("%9s %4s", "size", "2n");
+    for (int k = 0; k < NUM_COPY_KINDS; k++) printf(" %7s", copy_names[k]);
+    printf("  best\n");
+    for (int i = 0; i < cs.num_sizes; i++) {
+        char buf[32];
+        format_size(cs.sizes[i], buf, sizeof(buf));
+        printf("%9s %4s", buf, footprint_level(cs.sizes[i], levels));
+        for (int k = 0; k < NUM_COPY_KINDS; k++) {
+            if (cs.rate[i][k] == 0) printf(" %7s", "-");
+            else printf(" %7.2f", cs.rate[i][k]);
+        }
+        printf("  %s\n", copy_names[cs.best[i]]);
+    }
+    print_crossovers(&cs);
+}
+
+int main(int argc, char **argv) {
+    calibrate_timer();
+    int cpu = pin_to_first_cpu();
+
+    size_t measured[3], reported[3], levels[3];
+    probe_cache_sizes(&measured[0], &measured[1], &measured[2]);
+    os_cache_sizes(reported);
+
+    /*
+     * The chase knee can sit well below the real capacity (VMs, LLCs larger
+     * than the sweep), so the OS-reported size wins wherever there is one.
+     */
+    for (int l = 0; l < 3; l++) levels[l] = reported[l] ? reported[l] : measured[l];
+
+    printf("=== Copy strategies ===\n");
+    if (cpu >= 0) printf("Pinned to CPU %d\n", cpu);
+    printf("Measured caches: L1 %zu KB, L2 %zu KB, L3 %zu KB\n",
+           measured[0] / 1024, measured[1] / 1024, measured[2] / 1024);
+    printf("Reported caches: L1 %zu KB, L2 %zu KB, L3 %zu KB\n",
+           reported[0] / 1024, reported[1] / 1024, reported[2] / 1024);
+    printf("Bracketing:      L1 %zu KB, L2 %zu KB, L3 %zu KB\n",
+           levels[0] / 1024, levels[1] / 1024, levels[2] / 1024);
+
+    const char *mode = argc > 1 ? argv[1] : "all";
+    int matched = 0;
+    if (strcmp(mode, "all") == 0 || strcmp(mode, "aligned") == 0) {
+        run_copy_sweep(levels, 0, 0);
+        matched = 1;
+    }
+    if (strcmp(mode, "all") == 0 || strcmp(mode, "misaligned") == 0) {
+        run_copy_sweep(levels, 3, 1);
+        matched = 1;
+    }
+    if (!matched) {
+        printf("Usage: %s [all | aligned | misaligned]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
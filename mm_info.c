@@ -0,0 +1,686 @@
+/*
+ * Memory Management Cost Probes
+ * Measures page-fault and first-touch cost for the kernel's page backings
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* High-resolution timing */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t get_time(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t get_time(void) {
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+static inline uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/* Spin-wait hint */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+static double ticks_per_ns = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#define MAX_CPUS 1024
+
+/* CPUs this process may run on, ascending. Returns the count. */
+static int allowed_cpus(int *cpus, int max) {
+    int n = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++)
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        return n;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int c = 0; c < online && n < max; c++) cpus[n++] = c;
+    return n;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success. */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+/* Read one line of a sysfs file. Returns 0 on success. */
+static int read_sys_string(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* Parse a kernel CPU list such as "0-3,8,10-11". Returns the count. */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int cpu_in_list(int cpu, const int *list, int n) {
+    for (int i = 0; i < n; i++)
+        if (list[i] == cpu) return 1;
+    return 0;
+}
+
+/* CPUs sharing `cpu`'s SMT core or last-level cache, and its package */
+struct cpu_topology {
+    int siblings[MAX_CPUS];
+    int num_siblings;
+    int llc[MAX_CPUS];
+    int num_llc;
+    int package;
+};
+
+static void read_cpu_topology(int cpu, struct cpu_topology *t) {
+    char path[128], buf[4096];
+    memset(t, 0, sizeof(*t));
+    t->package = -1;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0)
+        t->num_siblings = parse_cpu_list(buf, t->siblings, MAX_CPUS);
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    if (read_sys_string(path, buf, sizeof(buf)) == 0) t->package = atoi(buf);
+
+    /* The highest cache level listed is the LLC */
+    int best_level = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) break;
+        int level = atoi(buf);
+        if (level < best_level) continue;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) continue;
+        best_level = level;
+        t->num_llc = parse_cpu_list(buf, t->llc, MAX_CPUS);
+    }
+}
+
+enum pair_class { PAIR_SMT, PAIR_LLC, PAIR_SOCKET, NUM_PAIRS };
+static const char *pair_names[NUM_PAIRS] = { "SMT sibling", "same LLC", "cross-socket" };
+
+/* One partner of `src` per distance class among `cpus`, -1 where none */
+static void pick_pair_cpus(const int *cpus, int n, int src, int *dst) {
+    struct cpu_topology topo;
+    read_cpu_topology(src, &topo);
+    for (int p = 0; p < NUM_PAIRS; p++) dst[p] = -1;
+    for (int i = 0; i < n; i++) {
+        int c = cpus[i];
+        if (c == src) continue;
+        if (cpu_in_list(c, topo.siblings, topo.num_siblings)) {
+            if (dst[PAIR_SMT] < 0) dst[PAIR_SMT] = c;
+        } else if (cpu_in_list(c, topo.llc, topo.num_llc)) {
+            if (dst[PAIR_LLC] < 0) dst[PAIR_LLC] = c;
+        } else if (dst[PAIR_SOCKET] < 0) {
+            struct cpu_topology other;
+            read_cpu_topology(c, &other);
+            if (other.package >= 0 && other.package != topo.package) dst[PAIR_SOCKET] = c;
+        }
+    }
+}
+
+/* System-wide event counters from /proc/vmstat */
+enum vm_counter { VM_PGFAULT, VM_THP_FAULT_ALLOC, VM_THP_FAULT_FALLBACK, NUM_VM_COUNTERS };
+static const char *vm_counter_names[NUM_VM_COUNTERS] = {
+    "pgfault", "thp_fault_alloc", "thp_fault_fallback",
+};
+
+static void read_vmstat(long long *counts) {
+    for (int i = 0; i < NUM_VM_COUNTERS; i++) counts[i] = -1;
+    FILE *f = fopen("/proc/vmstat", "r");
+    if (!f) return;
+    char name[64];
+    long long value;
+    while (fscanf(f, "%63s %lld", name, &value) == 2)
+        for (int i = 0; i < NUM_VM_COUNTERS; i++)
+            if (strcmp(name, vm_counter_names[i]) == 0) counts[i] = value;
+    fclose(f);
+}
+
+#define PAGE_4K 4096
+#define HUGE_2M (2 * 1024 * 1024)
+#define FAULT_REGION_BYTES (512 * 1024 * 1024)
+
+/*
+ * Anonymous region of `bytes`, 2MB-aligned so THP can back it. `extra`
+ * flags are added to mmap (MAP_HUGETLB, MAP_POPULATE). *base and *len
+ * receive what must be passed to munmap.
+ */
+static char *map_region(size_t bytes, int extra, void **base, size_t *len) {
+    if (extra & MAP_HUGETLB) {
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | extra, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        *base = p;
+        *len = bytes;
+        return (char *)p;
+    }
+    /* Reserve slack, align, then map the aligned span so MAP_POPULATE covers it */
+    void *p = mmap(NULL, bytes + HUGE_2M, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    char *aligned = (char *)(((uintptr_t)p + HUGE_2M - 1) & ~(uintptr_t)(HUGE_2M - 1));
+    if (mmap(aligned, bytes, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | extra, -1, 0) == MAP_FAILED) {
+        munmap(p, bytes + HUGE_2M);
+        return NULL;
+    }
+    *base = p;
+    *len = bytes + HUGE_2M;
+    return aligned;
+}
+
+/* Write one byte per `stride`; each write is a first touch. Returns total ns. */
+static double touch_pages(char *p, size_t bytes, size_t stride, double *each) {
+    uint64_t total = 0;
+    for (size_t off = 0, i = 0; off < bytes; off += stride, i++) {
+        uint64_t start = get_time();
+        *(volatile char *)(p + off) = 1;
+        uint64_t end = get_time();
+        total += end - start;
+        if (each) each[i] = (double)(end - start) / ticks_per_ns;
+    }
+    return (double)total / ticks_per_ns;
+}
+
+enum fault_kind { FAULT_4K, FAULT_THP, FAULT_HUGETLB, FAULT_POPULATE, NUM_FAULT_KINDS };
+static const char *fault_names[NUM_FAULT_KINDS] = {
+    "4KB anonymous", "THP", "hugetlbfs 2MB", "MAP_POPULATE",
+};
+
+struct fault_cost {
+    int ok;
+    size_t bytes;
+    size_t page;                    /* fault granule */
+    long faults;                    /* first touches, or pages populated */
+    double median_ns;               /* per fault; for populate, per page inside mmap */
+    double p99_ns;
+    double total_ns;                /* touch loop, plus mmap for populate */
+    long long vm_delta[NUM_VM_COUNTERS];
+    long long touch_faults;         /* pgfault delta of the touch loop alone */
+};
+
+/*
+ * First-touch cost of one backing. Each page is touched once with a
+ * single byte so the time is the fault: trap, allocation and zeroing.
+ * MAP_POPULATE moves all of that into mmap, which is timed as a whole,
+ * and the touch loop after it should take no faults at all.
+ */
+int probe_fault_cost(int kind, struct fault_cost *fc) {
+    memset(fc, 0, sizeof(*fc));
+    fc->bytes = FAULT_REGION_BYTES;
+    fc->page = kind == FAULT_THP || kind == FAULT_HUGETLB ? HUGE_2M : PAGE_4K;
+
+    if (kind == FAULT_HUGETLB) {
+        char buf[64];
+        long free_pages = 0;
+        if (read_sys_string("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages",
+                            buf, sizeof(buf)) == 0)
+            free_pages = atol(buf);
+        if ((size_t)free_pages * HUGE_2M < fc->bytes) fc->bytes = (size_t)free_pages * HUGE_2M;
+        if (fc->bytes == 0) return -1;
+    }
+    int extra = kind == FAULT_HUGETLB ? MAP_HUGETLB : kind == FAULT_POPULATE ? MAP_POPULATE : 0;
+    long pages = (long)(fc->bytes / fc->page);
+    double *each = (double *)malloc(pages * sizeof(double));
+    if (!each) return -1;
+
+    long long before[NUM_VM_COUNTERS], mapped[NUM_VM_COUNTERS], after[NUM_VM_COUNTERS];
+    read_vmstat(before);
+    void *base;
+    size_t len;
+    uint64_t start = get_time();
+    char *p = map_region(fc->bytes, extra, &base, &len);
+    uint64_t end = get_time();
+    if (!p) {
+        free(each);
+        return -1;
+    }
+    if (kind == FAULT_4K) madvise(p, fc->bytes, MADV_NOHUGEPAGE);
+#ifdef MADV_HUGEPAGE
+    if (kind == FAULT_THP) madvise(p, fc->bytes, MADV_HUGEPAGE);
+#endif
+
+    read_vmstat(mapped);
+    fc->total_ns = touch_pages(p, fc->bytes, fc->page, each);
+    read_vmstat(after);
+    munmap(base, len);
+
+    if (kind == FAULT_POPULATE) {
+        /* All the work happened in mmap; report it per 4KB page */
+        fc->total_ns += (double)(end - start) / ticks_per_ns;
+        fc->median_ns = fc->p99_ns = fc->total_ns / pages;
+    } else {
+        qsort(each, pages, sizeof(double), compare_double);
+        fc->median_ns = each[pages / 2];
+        fc->p99_ns = each[pages * 99 / 100];
+    }
+    fc->faults = pages;
+    for (int i = 0; i < NUM_VM_COUNTERS; i++)
+        fc->vm_delta[i] = before[i] >= 0 && after[i] >= 0 ? after[i] - before[i] : -1;
+    fc->touch_faults = mapped[VM_PGFAULT] >= 0 && after[VM_PGFAULT] >= 0 ?
+                       after[VM_PGFAULT] - mapped[VM_PGFAULT] : -1;
+    fc->ok = 1;
+    free(each);
+    return 0;
+}
+
+struct touch_worker {
+    pthread_t thread;
+    int cpu;
+    char *p;
+    size_t bytes;
+    volatile int *ready;
+    volatile int *go;
+} __attribute__((aligned(128)));
+
+static void *touch_thread(void *arg) {
+    struct touch_worker *w = (struct touch_worker *)arg;
+    pin_to_cpu(w->cpu);
+    __atomic_fetch_add(w->ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) cpu_relax();
+    touch_pages(w->p, w->bytes, PAGE_4K, NULL);
+    return NULL;
+}
+
+/*
+ * `threads` pinned workers first-touch disjoint slices of one 4KB-page
+ * region. Faults in one mm share its locks and page-table pages, so the
+ * aggregate rate shows how fault handling scales. Returns wall ns.
+ */
+static double time_parallel_touch(const int *cpus, int threads) {
+    void *base;
+    size_t len;
+    char *p = map_region(FAULT_REGION_BYTES, 0, &base, &len);
+    struct touch_worker *w = (struct touch_worker *)aligned_alloc(128, threads * sizeof(*w));
+    if (!p || !w) {
+        if (p) munmap(base, len);
+        free(w);
+        return -1.0;
+    }
+    madvise(p, FAULT_REGION_BYTES, MADV_NOHUGEPAGE);
+
+    volatile int ready = 0, go = 0;
+    size_t slice = FAULT_REGION_BYTES / threads / PAGE_4K * PAGE_4K;
+    for (int t = 0; t < threads; t++) {
+        w[t].cpu = cpus[t];
+        w[t].p = p + t * slice;
+        w[t].bytes = slice;
+        w[t].ready = &ready;
+        w[t].go = &go;
+        if (pthread_create(&w[t].thread, NULL, touch_thread, &w[t]) != 0) {
+            /* Release the ones already waiting; they just touch their slices */
+            __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+            for (int i = 0; i < t; i++) pthread_join(w[i].thread, NULL);
+            munmap(base, len);
+            free(w);
+            return -1.0;
+        }
+    }
+    while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) < threads) cpu_relax();
+
+    uint64_t start = get_time();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < threads; t++) pthread_join(w[t].thread, NULL);
+    uint64_t end = get_time();
+
+    munmap(base, len);
+    free(w);
+    return (double)(end - start) / ticks_per_ns;
+}
+
+static void run_faults(void) {
+    printf("=== First-touch cost, %d MB regions ===\n", FAULT_REGION_BYTES / (1024 * 1024));
+    printf("%-14s %6s %7s %10s %10s %8s %9s %9s %9s\n", "backing", "page", "faults",
+           "median ns", "p99 ns", "GB/s", "pgfault", "thp_alloc", "thp_fback");
+    for (int k = 0; k < NUM_FAULT_KINDS; k++) {
+        struct fault_cost fc;
+        if (probe_fault_cost(k, &fc) != 0) {
+            printf("%-14s %s\n", fault_names[k],
+                   k == FAULT_HUGETLB ? "no free hugetlbfs pages (vm.nr_hugepages)" : "mmap failed");
+            continue;
+        }
+        printf("%-14s %4zuKB %7ld %10.0f %10.0f %8.2f %9lld %9lld %9lld\n", fault_names[k],
+               fc.page / 1024, fc.faults, fc.median_ns, fc.p99_ns,
+               (double)fc.bytes / fc.total_ns, fc.vm_delta[VM_PGFAULT],
+               fc.vm_delta[VM_THP_FAULT_ALLOC], fc.vm_delta[VM_THP_FAULT_FALLBACK]);
+
+        /* vmstat is system-wide, so other activity can only add to the deltas */
+        if (fc.vm_delta[VM_PGFAULT] >= 0 && fc.vm_delta[VM_PGFAULT] < fc.faults)
+            printf("%14s vmstat counted fewer pgfaults than pages touched\n", "");
+        if (k == FAULT_THP && fc.vm_delta[VM_THP_FAULT_ALLOC] >= 0 &&
+            fc.vm_delta[VM_THP_FAULT_ALLOC] < fc.faults / 2)
+            printf("%14s most THP faults fell back to 4KB pages\n", "");
+        if (k == FAULT_POPULATE && fc.touch_faults > fc.faults / 100)
+            printf("%14s touch loop still faulted after MAP_POPULATE\n", "");
+    }
+
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    printf("\n=== Multi-threaded first touch, 4KB pages ===\n");
+    if (n < 2) printf("Only one CPU available; threads time-share.\n");
+    printf("%7s %8s %14s\n", "threads", "GB/s", "ns per fault");
+    long pages = FAULT_REGION_BYTES / PAGE_4K;
+    for (int t = 1;; t *= 2) {
+        if (t > n) t = n;
+        double ns = time_parallel_touch(cpus, t);
+        if (ns > 0)
+            printf("%7d %8.2f %14.0f\n", t, (double)FAULT_REGION_BYTES / ns, ns * t / pages);
+        if (t == n) break;
+    }
+}
+
+enum shoot_op { OP_MUNMAP, OP_MPROTECT, OP_DONTNEED, OP_NONE, NUM_SHOOT_OPS };
+static const char *shoot_op_names[NUM_SHOOT_OPS] = { "munmap", "mprotect", "DONTNEED", "quiet" };
+
+enum helper_cmd { CMD_TOUCH, CMD_MEASURE, CMD_STOP };
+
+#define SHOOT_ITERS 100
+#define SHOOT_TAIL_NS 20000
+
+/* Mapping shared with the helpers; each command reads it afresh */
+struct shoot_target {
+    char *volatile region;
+    volatile size_t bytes;
+    volatile int cmd;
+    volatile unsigned seq;
+};
+
+struct shoot_helper {
+    pthread_t thread;
+    int cpu;
+    int touch;                      /* read the mapping on CMD_TOUCH */
+    struct shoot_target *target;
+    volatile unsigned ack;
+    volatile uint64_t stall;        /* longest gap in the last window, ticks */
+} __attribute__((aligned(128)));
+
+/*
+ * Victim thread: spins reading the clock and keeps the longest gap
+ * between two readings. A shootdown IPI shows up as such a gap. Each
+ * new command publishes the window that just ended and starts another.
+ */
+static void *shoot_helper_thread(void *arg) {
+    struct shoot_helper *h = (struct shoot_helper *)arg;
+    struct shoot_target *t = h->target;
+    pin_to_cpu(h->cpu);
+    unsigned seen = 0;
+    uint64_t prev = get_time(), max = 0;
+    for (;;) {
+        unsigned s = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        if (s != seen) {
+            h->stall = max;
+            int cmd = t->cmd;
+            if (cmd == CMD_TOUCH && h->touch) {
+                /* Loads only: fill this CPU's TLB without dirtying anything */
+                char *p = t->region;
+                for (size_t off = 0; off < t->bytes; off += PAGE_4K)
+                    (void)*(volatile char *)(p + off);
+            }
+            seen = s;
+            __atomic_store_n(&h->ack, s, __ATOMIC_RELEASE);
+            if (cmd == CMD_STOP) break;
+            max = 0;
+            prev = get_time();
+            continue;
+        }
+        uint64_t now = get_time();
+        if (now - prev > max) max = now - prev;
+        prev = now;
+    }
+    return NULL;
+}
+
+static void shoot_issue(struct shoot_target *t, struct shoot_helper *h, int helpers, int cmd) {
+    t->cmd = cmd;
+    unsigned s = __atomic_add_fetch(&t->seq, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < helpers; i++)
+        while (__atomic_load_n(&h[i].ack, __ATOMIC_ACQUIRE) != s) cpu_relax();
+}
+
+/* Map, write-fault and keep 4KB pages so every op has PTEs to tear down */
+static char *shoot_map(size_t bytes) {
+    char *p = (char *)mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    madvise(p, bytes, MADV_NOHUGEPAGE);
+    for (size_t off = 0; off < bytes; off += PAGE_4K) p[off] = 1;
+    return p;
+}
+
+struct shootdown_cost {
+    double op_ns[NUM_SHOOT_OPS];    /* median latency of the call itself */
+    double stall_ns[NUM_SHOOT_OPS]; /* median of the worst victim gap per op */
+};
+
+/*
+ * Cost of shrinking a mapping's permissions while `helpers` other
+ * threads of the process are running on `cpus`. Touching helpers load
+ * every page into their TLBs first, as an allocator's callers would.
+ * Each op is timed on the calling thread; the victims' longest pause
+ * over the op plus a short tail measures the IPI they had to service.
+ * The "quiet" op does nothing and gives the background gap.
+ */
+int probe_shootdown(const int *cpus, int helpers, int touch, size_t bytes,
+                    struct shootdown_cost *sc) {
+    struct shoot_target target;
+    memset(&target, 0, sizeof(target));
+    target.bytes = bytes;
+    target.region = shoot_map(bytes);
+    if (!target.region) return -1;
+
+    struct shoot_helper *h = NULL;
+    if (helpers > 0) {
+        h = (struct shoot_helper *)aligned_alloc(128, helpers * sizeof(*h));
+        if (!h) {
+            munmap(target.region, bytes);
+            return -1;
+        }
+        memset(h, 0, helpers * sizeof(*h));
+    }
+    for (int i = 0; i < helpers; i++) {
+        h[i].cpu = cpus[i];
+        h[i].touch = touch;
+        h[i].target = &target;
+        if (pthread_create(&h[i].thread, NULL, shoot_helper_thread, &h[i]) != 0) {
+            shoot_issue(&target, h, i, CMD_STOP);
+            for (int j = 0; j < i; j++) pthread_join(h[j].thread, NULL);
+            munmap(target.region, bytes);
+            free(h);
+            return -1;
+        }
+    }
+
+    double op[SHOOT_ITERS], stall[SHOOT_ITERS];
+    for (int o = 0; o < NUM_SHOOT_OPS; o++) {
+        for (int it = 0; it < SHOOT_ITERS; it++) {
+            if (!target.region) target.region = shoot_map(bytes);
+            shoot_issue(&target, h, helpers, CMD_TOUCH);
+            shoot_issue(&target, h, helpers, CMD_MEASURE);
+
+            char *p = target.region;
+            uint64_t start = get_time();
+            if (o == OP_MUNMAP) munmap(p, bytes);
+            else if (o == OP_MPROTECT) mprotect(p, bytes, PROT_READ);
+            else if (o == OP_DONTNEED) madvise(p, bytes, MADV_DONTNEED);
+            uint64_t end = get_time();
+            while ((double)(get_time() - end) / ticks_per_ns < SHOOT_TAIL_NS) cpu_relax();
+            shoot_issue(&target, h, helpers, CMD_MEASURE);
+
+            op[it] = (double)(end - start) / ticks_per_ns;
+            uint64_t worst = 0;
+            for (int i = 0; i < helpers; i++)
+                if (h[i].stall > worst) worst = h[i].stall;
+            stall[it] = (double)worst / ticks_per_ns;
+
+            /* Restore the mapping outside the timed window */
+            if (o == OP_MUNMAP) {
+                target.region = NULL;
+            } else if (o == OP_MPROTECT) {
+                mprotect(p, bytes, PROT_READ | PROT_WRITE);
+                for (size_t off = 0; off < bytes; off += PAGE_4K) p[off] = 1;
+            } else if (o == OP_DONTNEED) {
+                for (size_t off = 0; off < bytes; off += PAGE_4K) p[off] = 1;
+            }
+        }
+        qsort(op, SHOOT_ITERS, sizeof(double), compare_double);
+        qsort(stall, SHOOT_ITERS, sizeof(double), compare_double);
+        sc->op_ns[o] = op[SHOOT_ITERS / 2];
+        sc->stall_ns[o] = helpers > 0 ? stall[SHOOT_ITERS / 2] : -1.0;
+    }
+
+    if (!target.region) target.region = shoot_map(bytes);
+    shoot_issue(&target, h, helpers, CMD_STOP);
+    for (int i = 0; i < helpers; i++) pthread_join(h[i].thread, NULL);
+    if (target.region) munmap(target.region, bytes);
+    free(h);
+    return 0;
+}
+
+static void print_shootdown_row(const char *label, int helpers, const struct shootdown_cost *sc) {
+    printf("%-22s %7d", label, helpers);
+    for (int o = 0; o < OP_NONE; o++) {
+        if (sc->stall_ns[o] < 0) printf("   %7.2f /     -", sc->op_ns[o] / 1000.0);
+        else printf("   %7.2f / %5.2f", sc->op_ns[o] / 1000.0, sc->stall_ns[o] / 1000.0);
+    }
+    if (sc->stall_ns[OP_NONE] < 0) printf(" %7s\n", "-");
+    else printf(" %7.2f\n", sc->stall_ns[OP_NONE] / 1000.0);
+}
+
+static void run_shootdown(void) {
+    int cpus[MAX_CPUS];
+    int n = allowed_cpus(cpus, MAX_CPUS);
+    int self = cpus[0];
+    pin_to_cpu(self);
+
+    /* Helpers never share the caller's CPU: a time-shared victim measures the scheduler */
+    int others[MAX_CPUS], num_others = 0;
+    for (int i = 1; i < n; i++) others[num_others++] = cpus[i];
+    int pair[NUM_PAIRS];
+    pick_pair_cpus(cpus, n, self, pair);
+
+    static const size_t sizes[] = { PAGE_4K, 16 * PAGE_4K, 512 * PAGE_4K };
+    printf("=== TLB shootdown cost, caller on CPU %d ===\n", self);
+    if (num_others == 0)
+        printf("Only one CPU available; no victims, so no IPIs to measure.\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        printf("\n%zu KB mapping (%zu pages), us: op latency / victim stall\n",
+               sizes[s] / 1024, sizes[s] / PAGE_4K);
+        printf("%-22s %7s", "victims", "threads");
+        for (int o = 0; o < OP_NONE; o++) printf(" %17s", shoot_op_names[o]);
+        printf(" %7s\n", shoot_op_names[OP_NONE]);
+
+        struct shootdown_cost sc;
+        if (probe_shootdown(NULL, 0, 1, sizes[s], &sc) == 0)
+            print_shootdown_row("none", 0, &sc);
+        for (int p = 0; p < NUM_PAIRS; p++) {
+            if (pair[p] < 0) continue;
+            if (probe_shootdown(&pair[p], 1, 1, sizes[s], &sc) == 0)
+                print_shootdown_row(pair_names[p], 1, &sc);
+        }
+        for (int k = 2; num_others >= 2; k *= 2) {
+            if (k > num_others) k = num_others;
+            char label[32];
+            snprintf(label, sizeof(label), "touched, CPU %d..%d", others[0], others[k - 1]);
+            if (probe_shootdown(others, k, 1, sizes[s], &sc) == 0)
+                print_shootdown_row(label, k, &sc);
+            if (k == num_others) break;
+        }
+        /* Threads of the mm that never touched the range still sit in its CPU mask */
+        if (num_others > 0 && probe_shootdown(others, num_others, 0, sizes[s], &sc) == 0)
+            print_shootdown_row("running, untouched", num_others, &sc);
+    }
+}
+
+int main(int argc, char **argv) {
+    calibrate_timer();
+
+    const char *mode = argc > 1 ? argv[1] : "faults";
+    if (strcmp(mode, "faults") == 0) {
+        run_faults();
+    } else if (strcmp(mode, "shootdown") == 0) {
+        run_shootdown();
+    } else {
+        printf("Usage: %s [faults | shootdown]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
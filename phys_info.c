@@ -0,0 +1,1052 @@
+/*
+ * Physical Address Probes
+ * Maps DRAM banks and L3 slices from physical addresses (/proc/self/pagemap)
+ * and timing
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* High-resolution timing */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t get_time(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t get_time(void) {
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+static inline uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline void memory_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("mfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("dmb sy" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/* Evict a line from every cache in the coherence domain */
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_FLUSH 1
+static inline void flush_line(const void *p) {
+    __asm__ __volatile__ ("clflush (%0)" :: "r"(p) : "memory");
+}
+#elif defined(__aarch64__)
+#define HAVE_FLUSH 1
+static inline void flush_line(const void *p) {
+    __asm__ __volatile__ ("dc civac, %0" :: "r"(p) : "memory");
+}
+#else
+#define HAVE_FLUSH 0
+static inline void flush_line(const void *p) {
+    (void)p;
+}
+#endif
+
+static double ticks_per_ns = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#define PAGE_4K 4096
+#define HUGE_2M (2 * 1024 * 1024)
+
+/*
+ * Physical address of `p` from /proc/self/pagemap, or 0 if the page is
+ * absent or the kernel hides PFNs (no CAP_SYS_ADMIN).
+ */
+static uint64_t virt_to_phys(int fd, const void *p) {
+    uint64_t entry;
+    off_t off = (off_t)((uintptr_t)p / PAGE_4K) * sizeof(entry);
+    if (fd < 0 || pread(fd, &entry, sizeof(entry), off) != sizeof(entry)) return 0;
+    if (!(entry & (1ULL << 63))) return 0;
+    uint64_t pfn = entry & ((1ULL << 55) - 1);
+    if (pfn == 0) return 0;
+    return pfn * PAGE_4K + (uintptr_t)p % PAGE_4K;
+}
+
+/* 2MB-aligned, THP-backed where possible, touched so every page has a PFN */
+static char *alloc_physical(size_t bytes) {
+    void *p = NULL;
+    if (posix_memalign(&p, HUGE_2M, bytes) != 0) return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    memset(p, 1, bytes);
+    return (char *)p;
+}
+
+/* Whether the 2MB region at p maps to one contiguous physical range */
+static int physically_contiguous(int fd, const char *p) {
+    uint64_t base = virt_to_phys(fd, p);
+    if (base == 0) return 0;
+    for (size_t off = PAGE_4K; off < HUGE_2M; off += PAGE_4K)
+        if (virt_to_phys(fd, p + off) != base + off) return 0;
+    return 1;
+}
+
+/* AnonHugePages of the mapping containing addr, from /proc/self/smaps; 0 if unknown */
+static size_t anon_huge_bytes(const void *addr) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+
+    char line[256];
+    int found = 0;
+    size_t huge = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        size_t kb;
+        /* Field lines start with "Name:", mapping headers with "start-end" */
+        char *sp = strchr(line, ' ');
+        int is_field = sp && sp > line && sp[-1] == ':';
+        if (!is_field && sscanf(line, "%lx-%lx", &start, &end) == 2) {
+            if (found) break;
+            found = (uintptr_t)addr >= start && (uintptr_t)addr < end;
+        } else if (found && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            huge = kb * 1024;
+        }
+    }
+    fclose(f);
+    return huge;
+}
+
+#define DRAM_BUFFER_BYTES (256 * 1024 * 1024)
+#define DRAM_PAIR_REPS 101
+#define DRAM_SAMPLES 2000
+#define DRAM_MAX_FN_BITS 6
+#define DRAM_MAX_FNS 16
+#define DRAM_LOW_BIT 6
+#define DRAM_HIGH_BIT 40
+
+/*
+ * Median ns to load a and b together from DRAM. Both lines are flushed
+ * first, so the pair opens rows: same row is a hit for the second load,
+ * different banks open in parallel, and the same bank with a different
+ * row serializes on a precharge and activate.
+ */
+static double time_dram_pair(const char *a, const char *b) {
+    double samples[DRAM_PAIR_REPS];
+    for (int r = 0; r < DRAM_PAIR_REPS; r++) {
+        flush_line(a);
+        flush_line(b);
+        memory_barrier();
+        uint64_t start = get_time();
+        (void)*(volatile const char *)a;
+        (void)*(volatile const char *)b;
+        memory_barrier();
+        uint64_t end = get_time();
+        samples[r] = (double)(end - start) / ticks_per_ns;
+    }
+    qsort(samples, DRAM_PAIR_REPS, sizeof(double), compare_double);
+    return samples[DRAM_PAIR_REPS / 2];
+}
+
+/* Two-means split of sorted latencies; returns the threshold between them */
+static double split_two_clusters(const double *sorted, int n, double *low, double *high) {
+    double lo = sorted[0], hi = sorted[n - 1];
+    for (int iter = 0; iter < 50; iter++) {
+        double mid = (lo + hi) / 2, sum_lo = 0, sum_hi = 0;
+        int n_lo = 0, n_hi = 0;
+        for (int i = 0; i < n; i++) {
+            if (sorted[i] < mid) { sum_lo += sorted[i]; n_lo++; }
+            else { sum_hi += sorted[i]; n_hi++; }
+        }
+        if (n_lo == 0 || n_hi == 0) break;
+        lo = sum_lo / n_lo;
+        hi = sum_hi / n_hi;
+    }
+    *low = lo;
+    *high = hi;
+    return (lo + hi) / 2;
+}
+
+static int parity64(uint64_t x) {
+    return __builtin_parityll(x);
+}
+
+/* Next integer with the same number of set bits (Gosper's hack) */
+static uint64_t next_combination(uint64_t x) {
+    uint64_t c = x & -x, r = x + c;
+    return (((r ^ x) >> 2) / c) | r;
+}
+
+enum bit_role { BIT_COLUMN, BIT_BANK, BIT_ROW, BIT_UNKNOWN };
+static const char *bit_role_names[] = { "column", "bank", "row", "?" };
+
+struct dram_map {
+    double hit_ns;                  /* same row */
+    double miss_ns;                 /* different bank: each access opens its own row */
+    double conflict_ns;             /* same bank, different row */
+    double threshold_ns;            /* conflict above this */
+    int num_samples;
+    int num_conflicts;
+    int separated;                  /* conflict cluster clearly above miss */
+    int have_phys;                  /* pagemap PFNs readable */
+    int flip_max_bit;               /* bits DRAM_LOW_BIT..flip_max_bit were flipped */
+    int flip_limited;               /* contiguity unconfirmed, flips kept within 4KB */
+    int bit_role[64];
+    int num_fns;
+    uint64_t fns[DRAM_MAX_FNS];     /* XOR masks of physical bits selecting the bank */
+};
+
+/*
+ * Sample random lines against a base line and split the pair latencies
+ * into bank-conflict and no-conflict clusters. Then flip each address bit
+ * inside one physically contiguous 2MB page to classify it as column,
+ * bank or row. With physical addresses, search XOR masks of up to
+ * DRAM_MAX_FN_BITS bits that every conflicting address shares with the
+ * base but that split the other samples, and keep an independent set.
+ */
+int probe_dram_map(struct dram_map *dm) {
+    memset(dm, 0, sizeof(*dm));
+    if (!HAVE_FLUSH) return -1;
+
+    char *buf = alloc_physical(DRAM_BUFFER_BYTES);
+    double *lat = (double *)malloc(DRAM_SAMPLES * sizeof(double));
+    double *sorted = (double *)malloc(DRAM_SAMPLES * sizeof(double));
+    uint64_t *phys = (uint64_t *)malloc(DRAM_SAMPLES * sizeof(uint64_t));
+    if (!buf || !lat || !sorted || !phys) {
+        free(buf);
+        free(lat);
+        free(sorted);
+        free(phys);
+        return -1;
+    }
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    const char *base = buf;
+    uint64_t base_phys = virt_to_phys(fd, base);
+    dm->have_phys = base_phys != 0;
+
+    /* Same row: neighbouring columns of the base line */
+    double hits[4];
+    for (int i = 0; i < 4; i++) hits[i] = time_dram_pair(base, base + 64 * (i + 1));
+    qsort(hits, 4, sizeof(double), compare_double);
+    dm->hit_ns = hits[0];
+
+    size_t num_lines = DRAM_BUFFER_BYTES / 64;
+    for (int s = 0; s < DRAM_SAMPLES; s++) {
+        const char *b = buf + ((size_t)rand() % num_lines) * 64;
+        if (b - base < HUGE_2M) b += HUGE_2M;       /* stay off the base's own page */
+        lat[s] = time_dram_pair(base, b);
+        phys[s] = virt_to_phys(fd, b);
+    }
+    dm->num_samples = DRAM_SAMPLES;
+    memcpy(sorted, lat, DRAM_SAMPLES * sizeof(double));
+    qsort(sorted, DRAM_SAMPLES, sizeof(double), compare_double);
+    dm->threshold_ns = split_two_clusters(sorted, DRAM_SAMPLES, &dm->miss_ns, &dm->conflict_ns);
+    for (int s = 0; s < DRAM_SAMPLES; s++)
+        if (lat[s] > dm->threshold_ns) dm->num_conflicts++;
+    /* Conflicts are rare (about one bank in N) and clearly slower */
+    dm->separated = dm->conflict_ns > 1.1 * dm->miss_ns &&
+                    dm->num_conflicts < DRAM_SAMPLES / 2;
+
+    /*
+     * Bit flips need physical contiguity: check the pagemap if PFNs are
+     * readable, otherwise that smaps shows the buffer backed by huge pages.
+     */
+    int contiguous = dm->have_phys ? physically_contiguous(fd, base)
+                                   : anon_huge_bytes(base) >= DRAM_BUFFER_BYTES;
+    dm->flip_max_bit = contiguous ? 20 : 11;
+    dm->flip_limited = !contiguous;
+    for (int b = 0; b < 64; b++) dm->bit_role[b] = BIT_UNKNOWN;
+    if (dm->separated) {
+        for (int b = DRAM_LOW_BIT; b <= dm->flip_max_bit; b++) {
+            double ns = time_dram_pair(base, base + ((size_t)1 << b));
+            if (ns < (dm->hit_ns + dm->miss_ns) / 2) dm->bit_role[b] = BIT_COLUMN;
+            else if (ns > dm->threshold_ns) dm->bit_role[b] = BIT_ROW;
+            else dm->bit_role[b] = BIT_BANK;
+        }
+    }
+
+    if (dm->have_phys && dm->separated && dm->num_conflicts > 0) {
+        /* Highest physical bit that varies across the samples */
+        uint64_t varying = 0;
+        for (int s = 0; s < DRAM_SAMPLES; s++) varying |= phys[s] ^ base_phys;
+        int high = DRAM_LOW_BIT;
+        while (high < DRAM_HIGH_BIT && (varying >> (high + 1))) high++;
+        int width = high - DRAM_LOW_BIT + 1;
+
+        /* Independent masks, in order of weight, kept as a row-echelon basis */
+        uint64_t basis[64] = { 0 };
+        for (int k = 1; k <= DRAM_MAX_FN_BITS && k <= width && dm->num_fns < DRAM_MAX_FNS; k++) {
+            for (uint64_t x = (1ULL << k) - 1; x < (1ULL << width); x = next_combination(x)) {
+                uint64_t mask = x << DRAM_LOW_BIT;
+                int ok = 1, ones = 0, others = 0;
+                for (int s = 0; s < DRAM_SAMPLES && ok; s++) {
+                    int differs = parity64((phys[s] ^ base_phys) & mask);
+                    if (lat[s] > dm->threshold_ns) {
+                        if (differs) ok = 0;
+                    } else {
+                        ones += differs;
+                        others++;
+                    }
+                }
+                /* A bank function splits the non-conflicting samples roughly in half */
+                if (!ok || ones < others / 4 || ones > others * 3 / 4) continue;
+
+                uint64_t r = mask;
+                for (int b = 63; b >= 0 && r; b--)
+                    if (((r >> b) & 1) && basis[b]) r ^= basis[b];
+                if (!r) continue;
+                basis[63 - __builtin_clzll(r)] = r;
+                dm->fns[dm->num_fns++] = mask;
+                if (dm->num_fns == DRAM_MAX_FNS) break;
+            }
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    free(buf);
+    free(lat);
+    free(sorted);
+    free(phys);
+    return 0;
+}
+
+static void print_mask_bits(uint64_t mask) {
+    int first = 1;
+    for (int b = 0; b < 64; b++) {
+        if (!((mask >> b) & 1)) continue;
+        printf(first ? "%d" : " ^ %d", b);
+        first = 0;
+    }
+}
+
+static void run_dram_map(void) {
+    printf("=== DRAM row buffer and bank mapping ===\n");
+    struct dram_map dm;
+    if (probe_dram_map(&dm) != 0) {
+        printf("Needs a cache-line flush instruction and %d MB of memory\n",
+               DRAM_BUFFER_BYTES / (1024 * 1024));
+        return;
+    }
+
+    printf("Row hit (same row):          %6.1f ns\n", dm.hit_ns);
+    printf("Row miss (different bank):   %6.1f ns\n", dm.miss_ns);
+    printf("Bank conflict (same bank):   %6.1f ns  (%d of %d samples)\n",
+           dm.conflict_ns, dm.num_conflicts, dm.num_samples);
+    if (!dm.separated) {
+        printf("No distinct conflict cluster; the controller may use a closed-page\n"
+               "policy, or a hypervisor hides the timing.\n");
+        return;
+    }
+    printf("Conflict threshold:          %6.1f ns, ~%.0f banks\n", dm.threshold_ns,
+           dm.num_conflicts ? (double)dm.num_samples / dm.num_conflicts : 0.0);
+
+    printf("\nAddress bits %d-%d by single-bit flip:\n", DRAM_LOW_BIT, dm.flip_max_bit);
+    if (dm.flip_limited)
+        printf("(limited to the 4KB page: no physically contiguous 2MB page confirmed)\n");
+    for (int b = DRAM_LOW_BIT; b <= dm.flip_max_bit; b++)
+        printf("  bit %2d: %s\n", b, bit_role_names[dm.bit_role[b]]);
+
+    if (!dm.have_phys) {
+        printf("\nPhysical addresses unavailable (pagemap PFNs need CAP_SYS_ADMIN);\n"
+               "bank functions above bit %d not inferred.\n", dm.flip_max_bit);
+        return;
+    }
+    printf("\nBank-select XOR functions of physical address bits (channel, rank and bank):\n");
+    if (dm.num_fns == 0) printf("  none found\n");
+    int lowest = 64;
+    for (int i = 0; i < dm.num_fns; i++) {
+        printf("  ");
+        print_mask_bits(dm.fns[i]);
+        printf("\n");
+        int low = __builtin_ctzll(dm.fns[i]);
+        if (low < lowest) lowest = low;
+    }
+    if (dm.num_fns)
+        printf("%d functions, %d banks; a %zu-byte step changes bank\n",
+               dm.num_fns, 1 << dm.num_fns, (size_t)1 << lowest);
+}
+
+/*
+ * Wait for earlier instructions, loads included, to finish before the
+ * next timestamp, so a single load can be timed.
+ */
+static inline void execution_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("lfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("isb" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+#define MAX_CPUS 1024
+
+/* CPUs this process may run on, ascending. Returns the count. */
+static int allowed_cpus(int *cpus, int max) {
+    int n = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++)
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        return n;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int c = 0; c < online && n < max; c++) cpus[n++] = c;
+    return n;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success. */
+static int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+/* Read one line of a sysfs file. Returns 0 on success. */
+static int read_sys_string(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* Parse a kernel CPU list such as "0-3,8,10-11". Returns the count. */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int cpu_in_list(int cpu, const int *list, int n) {
+    for (int i = 0; i < n; i++)
+        if (list[i] == cpu) return 1;
+    return 0;
+}
+
+/*
+ * Allowed CPUs that share `cpu`'s last-level cache, one hardware thread
+ * per core. Returns the count; falls back to every allowed CPU.
+ */
+static int llc_core_cpus(int cpu, const int *allowed, int n, int *out, int max) {
+    char path[128], buf[4096];
+    static int llc[MAX_CPUS], siblings[MAX_CPUS];
+    int num_llc = 0, count = 0;
+
+    int best_level = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) break;
+        int level = atoi(buf);
+        if (level < best_level) continue;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) continue;
+        best_level = level;
+        num_llc = parse_cpu_list(buf, llc, MAX_CPUS);
+    }
+
+    for (int i = 0; i < n && count < max; i++) {
+        int c = allowed[i];
+        if (num_llc && !cpu_in_list(c, llc, num_llc)) continue;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        int num_siblings = 0;
+        if (read_sys_string(path, buf, sizeof(buf)) == 0)
+            num_siblings = parse_cpu_list(buf, siblings, MAX_CPUS);
+        /* Keep the first allowed sibling of each core */
+        int dup = 0;
+        for (int s = 0; s < num_siblings && siblings[s] != c; s++)
+            if (cpu_in_list(siblings[s], out, count)) dup = 1;
+        if (!dup) out[count++] = c;
+    }
+    return count;
+}
+
+static size_t l2_cache_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 1024 * 1024;
+}
+
+static size_t l3_cache_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 0;
+}
+
+#define SLICE_BUFFER_BYTES (512 * 1024 * 1024)
+#define SLICE_SAMPLES 4096
+#define SLICE_LAPS 9
+#define SLICE_MAX_CPUS 64
+#define SLICE_MAX 64
+#define SLICE_MAX_FNS 6
+#define SLICE_COUNTER_LINES 1024
+#define SLICE_COUNTER_REPS 1000
+
+struct slice_map {
+    int num_cpus;
+    int cpus[SLICE_MAX_CPUS];       /* one per core sharing the LLC */
+    int num_lines;
+    uint64_t phys[SLICE_SAMPLES];
+    float lat[SLICE_SAMPLES][SLICE_MAX_CPUS];   /* ns beyond an L1 hit */
+    int slice[SLICE_SAMPLES];       /* -1 if unknown */
+    int num_slices;
+    int by_counters;                /* slices from uncore C-box counters, else nearest CPU */
+    int near_cpu[SLICE_MAX];
+    double slice_lat[SLICE_MAX][SLICE_MAX_CPUS];
+    int num_fns;                    /* 0 if no linear hash fits */
+    uint64_t fns[SLICE_MAX_FNS];
+    int code_slice[1 << SLICE_MAX_FNS];
+    double agreement;               /* labelled lines the hash reproduces */
+    uint64_t fixed_mask;            /* physical bits constant across the sample */
+    uint64_t fixed_value;           /* the hash is unverified where these differ */
+};
+
+/*
+ * Per-line hit latency from the current CPU. The ring holds twice the L2,
+ * so every hop misses L2 and hits L3; only the first SLICE_SAMPLES hops
+ * are timed. Median over laps, minus a timed L1 hit.
+ */
+static void time_slice_ring(char *start, size_t ring_len, int n, float *out, int stride) {
+    static float laps[SLICE_LAPS][SLICE_SAMPLES];
+    char *p = start;
+    for (int lap = -1; lap < SLICE_LAPS; lap++) {
+        for (size_t i = 0; i < ring_len; i++) {
+            if ((int)i >= n) {
+                p = *(char **)p;
+                continue;
+            }
+            execution_barrier();
+            uint64_t t0 = get_time();
+            p = *(char **)p;
+            execution_barrier();
+            uint64_t t1 = get_time();
+            if (lap >= 0) laps[lap][i] = (float)((double)(t1 - t0) / ticks_per_ns);
+        }
+    }
+
+    /* The same timed hop on a line that points to itself */
+    static char *self[8] __attribute__((aligned(64)));
+    self[0] = (char *)self;
+    char *q = (char *)self;
+    double l1[SLICE_LAPS * 4];
+    for (int r = 0; r < SLICE_LAPS * 4; r++) {
+        execution_barrier();
+        uint64_t t0 = get_time();
+        q = *(char **)q;
+        execution_barrier();
+        uint64_t t1 = get_time();
+        l1[r] = (double)(t1 - t0) / ticks_per_ns;
+    }
+    qsort(l1, SLICE_LAPS * 4, sizeof(double), compare_double);
+    char *volatile sink = p; (void)sink;
+    sink = q;
+
+    double v[SLICE_LAPS];
+    for (int i = 0; i < n; i++) {
+        for (int lap = 0; lap < SLICE_LAPS; lap++) v[lap] = laps[lap][i];
+        qsort(v, SLICE_LAPS, sizeof(double), compare_double);
+        out[(size_t)i * stride] = (float)(v[SLICE_LAPS / 2] - l1[SLICE_LAPS * 2]);
+    }
+}
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CBOX 1
+/* UNC_CBO_CACHE_LOOKUP.ANY_MESI on client parts */
+#define CBOX_LOOKUP_CONFIG 0x8f34
+
+/* Open one lookup counter per C-box on `cpu`. Returns the count, 0 if none. */
+static int open_cbox_counters(int cpu, int *fds, int max) {
+    char path[128], buf[64];
+    int n = 0;
+    for (; n < max; n++) {
+        snprintf(path, sizeof(path), "/sys/bus/event_source/devices/uncore_cbox_%d/type", n);
+        if (read_sys_string(path, buf, sizeof(buf)) != 0) break;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = (uint32_t)atoi(buf);
+        attr.size = sizeof(attr);
+        attr.config = CBOX_LOOKUP_CONFIG;
+        attr.disabled = 1;
+        fds[n] = (int)syscall(__NR_perf_event_open, &attr, -1, cpu, -1, 0);
+        if (fds[n] < 0) break;
+    }
+    if (n < 2) {
+        for (int i = 0; i < n; i++) close(fds[i]);
+        return 0;
+    }
+    return n;
+}
+
+/* The C-box that saw the most lookups while the line was flushed and reloaded */
+static int cbox_of_line(const char *line, const int *fds, int n) {
+    for (int i = 0; i < n; i++) {
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    for (int r = 0; r < SLICE_COUNTER_REPS; r++) {
+        flush_line(line);
+        memory_barrier();
+        (void)*(volatile const char *)line;
+    }
+    int best = -1;
+    uint64_t best_count = 0;
+    for (int i = 0; i < n; i++) {
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fds[i], &count, sizeof(count)) != sizeof(count)) continue;
+        if (count > best_count) {
+            best_count = count;
+            best = i;
+        }
+    }
+    return best;
+}
+#else
+#define HAVE_CBOX 0
+#endif
+
+/*
+ * Candidate slice hash from same-slice differences taken in `order`.
+ * Lines in one slice differ only inside the hash's null space, so the
+ * span of their XOR differences is that null space and the hash rows
+ * span its annihilator. The span is capped at the expected null-space
+ * rank, so a mislabelled line late in the order cannot collapse it.
+ * Returns the number of rows written to fns.
+ */
+static int slice_hash_candidate(const struct slice_map *sm, const int *order,
+                                uint64_t varying, int cap, uint64_t *fns) {
+    uint64_t first[SLICE_MAX];
+    int seen[SLICE_MAX] = { 0 };
+
+    /* Reduced row echelon basis, keyed by pivot bit */
+    uint64_t basis[64] = { 0 };
+    int rank = 0;
+    for (int k = 0; k < sm->num_lines && rank < cap; k++) {
+        int i = order[k], s = sm->slice[i];
+        if (s < 0) continue;
+        if (!seen[s]) {
+            seen[s] = 1;
+            first[s] = sm->phys[i];
+            continue;
+        }
+        uint64_t r = (sm->phys[i] ^ first[s]) & varying;
+        for (int b = 63; b >= 0 && r; b--)
+            if (((r >> b) & 1) && basis[b]) r ^= basis[b];
+        if (!r) continue;
+        int pivot = 63 - __builtin_clzll(r);
+        for (int b = 0; b < 64; b++)
+            if (basis[b] && ((basis[b] >> pivot) & 1)) basis[b] ^= r;
+        basis[pivot] = r;
+        rank++;
+    }
+
+    /* One annihilator row per varying non-pivot bit */
+    int num = 0;
+    for (int f = 6; f < 64 && num < SLICE_MAX_FNS; f++) {
+        if (!((varying >> f) & 1) || basis[f]) continue;
+        uint64_t m = 1ULL << f;
+        for (int b = 0; b < 64; b++)
+            if (basis[b] && ((basis[b] >> f) & 1)) m |= 1ULL << b;
+        fns[num++] = m;
+    }
+    return num;
+}
+
+/* Map each hash code to its majority slice; returns the labelled lines that agree */
+static double slice_hash_agreement(const struct slice_map *sm, const uint64_t *fns, int num,
+                                   int *code_slice) {
+    static int votes[1 << SLICE_MAX_FNS][SLICE_MAX];
+    memset(votes, 0, sizeof(votes));
+    for (int i = 0; i < sm->num_lines; i++) {
+        if (sm->slice[i] < 0) continue;
+        int code = 0;
+        for (int k = 0; k < num; k++) code |= parity64(sm->phys[i] & fns[k]) << k;
+        votes[code][sm->slice[i]]++;
+    }
+    int agree = 0, total = 0;
+    for (int code = 0; code < (1 << num); code++) {
+        int best = 0;
+        for (int s = 0; s < sm->num_slices; s++) {
+            if (votes[code][s] > votes[code][best]) best = s;
+            total += votes[code][s];
+        }
+        code_slice[code] = best;
+        agree += votes[code][best];
+    }
+    return total ? (double)agree / total : 0.0;
+}
+
+#define SLICE_FIT_TRIALS 16
+
+/*
+ * Fit a linear slice hash to the labelled lines: log2(slices) XOR masks
+ * of physical bits. Timing labels are noisy, so candidates are built from
+ * random line orders and the one reproducing most labels wins; it is kept
+ * only above 90% agreement.
+ */
+static void fit_slice_hash(struct slice_map *sm) {
+    sm->num_fns = 0;
+    int bits = 0;
+    while ((1 << bits) < sm->num_slices) bits++;
+    if (bits == 0 || (1 << bits) != sm->num_slices || bits > SLICE_MAX_FNS) return;
+
+    uint64_t varying = 0;
+    for (int i = 0; i < sm->num_lines; i++) varying |= sm->phys[i] ^ sm->phys[0];
+    varying &= ~63ULL;
+    sm->fixed_mask = ~varying & ~63ULL;
+    sm->fixed_value = sm->phys[0] & sm->fixed_mask;
+    int cap = __builtin_popcountll(varying) - bits;
+    if (cap < 0) return;
+
+    static int order[SLICE_SAMPLES];
+    for (int i = 0; i < sm->num_lines; i++) order[i] = i;
+    double best = 0.0;
+    for (int trial = 0; trial < SLICE_FIT_TRIALS; trial++) {
+        for (int i = sm->num_lines - 1; i > 0; i--) {
+            int j = rand() % (i + 1), tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        uint64_t fns[SLICE_MAX_FNS];
+        int code_slice[1 << SLICE_MAX_FNS];
+        if (slice_hash_candidate(sm, order, varying, cap, fns) != bits) continue;
+        double agree = slice_hash_agreement(sm, fns, bits, code_slice);
+        if (agree <= best) continue;
+        best = agree;
+        memcpy(sm->fns, fns, bits * sizeof(uint64_t));
+        memcpy(sm->code_slice, code_slice, sizeof(code_slice));
+    }
+    sm->agreement = best;
+    if (best >= 0.9) sm->num_fns = bits;
+}
+
+static int slice_of_phys(const struct slice_map *sm, uint64_t phys) {
+    int code = 0;
+    for (int k = 0; k < sm->num_fns; k++) code |= parity64(phys & sm->fns[k]) << k;
+    return sm->code_slice[code];
+}
+
+/*
+ * L3 slice map. Time every sampled line from each core sharing the LLC;
+ * label lines by C-box lookup counters where the uncore PMU allows it,
+ * else by the core that reaches them fastest (its co-located slice).
+ * Then fit a linear hash and average latency per slice and core.
+ */
+int probe_slice_map(struct slice_map *sm) {
+    memset(sm, 0, sizeof(*sm));
+    int allowed[MAX_CPUS];
+    int n = allowed_cpus(allowed, MAX_CPUS);
+    if (n < 1) return -1;
+    sm->num_cpus = llc_core_cpus(allowed[0], allowed, n, sm->cpus, SLICE_MAX_CPUS);
+    if (sm->num_cpus < 1) return -1;
+
+    size_t ring_bytes = 2 * l2_cache_size();
+    size_t l3 = l3_cache_size();
+    if (l3 && ring_bytes > l3 / 2) ring_bytes = l3 / 2;
+    size_t ring_len = ring_bytes / 64;
+    if (ring_len < SLICE_SAMPLES) ring_len = SLICE_SAMPLES;
+    sm->num_lines = SLICE_SAMPLES;
+
+    char *buf = alloc_physical(SLICE_BUFFER_BYTES);
+    char **lines = (char **)malloc(ring_len * sizeof(char *));
+    if (!buf || !lines) {
+        free(buf);
+        free(lines);
+        return -1;
+    }
+
+    /* Distinct random lines from across the buffer, linked into a ring */
+    size_t num_buf_lines = SLICE_BUFFER_BYTES / 64;
+    for (size_t i = 0; i < ring_len; i++) {
+        size_t idx;
+        do {
+            idx = ((size_t)rand() * 65536 + (size_t)rand()) % num_buf_lines;
+        } while (*(char **)(buf + idx * 64) == (char *)1);
+        lines[i] = buf + idx * 64;
+        *(char **)lines[i] = (char *)1;
+    }
+    for (size_t i = 0; i < ring_len; i++)
+        *(char **)lines[i] = lines[(i + 1) % ring_len];
+
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    for (int i = 0; i < sm->num_lines; i++) sm->phys[i] = virt_to_phys(fd, lines[i]);
+    if (fd >= 0) close(fd);
+
+    for (int c = 0; c < sm->num_cpus; c++) {
+        pin_to_cpu(sm->cpus[c]);
+        time_slice_ring(lines[0], ring_len, sm->num_lines, &sm->lat[0][c], SLICE_MAX_CPUS);
+    }
+
+    for (int i = 0; i < sm->num_lines; i++) sm->slice[i] = -1;
+#if HAVE_CBOX
+    int fds[SLICE_MAX];
+    int boxes = open_cbox_counters(sm->cpus[0], fds, SLICE_MAX);
+    if (boxes > 0) {
+        pin_to_cpu(sm->cpus[0]);
+        for (int i = 0; i < sm->num_lines && i < SLICE_COUNTER_LINES; i++)
+            sm->slice[i] = cbox_of_line(lines[i], fds, boxes);
+        for (int i = 0; i < boxes; i++) close(fds[i]);
+        sm->by_counters = 1;
+        sm->num_slices = boxes;
+    }
+#endif
+    if (!sm->by_counters) {
+        for (int i = 0; i < sm->num_lines; i++) {
+            int best = 0;
+            for (int c = 1; c < sm->num_cpus; c++)
+                if (sm->lat[i][c] < sm->lat[i][best]) best = c;
+            sm->slice[i] = best;
+        }
+        sm->num_slices = sm->num_cpus < SLICE_MAX ? sm->num_cpus : SLICE_MAX;
+    }
+
+    int have_phys = 1;
+    for (int i = 0; i < sm->num_lines; i++)
+        if (sm->phys[i] == 0) have_phys = 0;
+    if (have_phys) fit_slice_hash(sm);
+    /* Lines the counters did not cover take the fitted hash's answer */
+    if (sm->num_fns)
+        for (int i = 0; i < sm->num_lines; i++)
+            if (sm->slice[i] < 0) sm->slice[i] = slice_of_phys(sm, sm->phys[i]);
+
+    static int counts[SLICE_MAX];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < sm->num_lines; i++) {
+        int s = sm->slice[i];
+        if (s < 0) continue;
+        counts[s]++;
+        for (int c = 0; c < sm->num_cpus; c++) sm->slice_lat[s][c] += sm->lat[i][c];
+    }
+    for (int s = 0; s < sm->num_slices; s++) {
+        sm->near_cpu[s] = sm->cpus[0];
+        if (!counts[s]) continue;
+        int best = 0;
+        for (int c = 0; c < sm->num_cpus; c++) {
+            sm->slice_lat[s][c] /= counts[s];
+            if (sm->slice_lat[s][c] < sm->slice_lat[s][best]) best = c;
+        }
+        sm->near_cpu[s] = sm->cpus[best];
+    }
+
+    pin_to_cpu(allowed[0]);
+    free(buf);
+    free(lines);
+    return 0;
+}
+
+/*
+ * Table format, one record per line:
+ *   cpus <cpu>...
+ *   fn <hex mask>              (one per hash bit, low bit first)
+ *   code <code> <slice>
+ *   slice <id> <near cpu> <ns from each cpu>...
+ *   line <hex physical address> <slice>
+ */
+static int write_slice_table(const struct slice_map *sm, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    fprintf(out, "# phys_info L3 slice table (%s)\n",
+            sm->by_counters ? "uncore counters" : "nearest-core timing");
+    fprintf(out, "cpus");
+    for (int c = 0; c < sm->num_cpus; c++) fprintf(out, " %d", sm->cpus[c]);
+    fprintf(out, "\n");
+    for (int k = 0; k < sm->num_fns; k++) fprintf(out, "fn %#llx\n", (unsigned long long)sm->fns[k]);
+    if (sm->num_fns)
+        fprintf(out, "fixed %#llx %#llx\n", (unsigned long long)sm->fixed_mask,
+                (unsigned long long)sm->fixed_value);
+    for (int code = 0; sm->num_fns && code < (1 << sm->num_fns); code++)
+        fprintf(out, "code %d %d\n", code, sm->code_slice[code]);
+    for (int s = 0; s < sm->num_slices; s++) {
+        fprintf(out, "slice %d %d", s, sm->near_cpu[s]);
+        for (int c = 0; c < sm->num_cpus; c++) fprintf(out, " %.1f", sm->slice_lat[s][c]);
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < sm->num_lines; i++)
+        if (sm->phys[i] && sm->slice[i] >= 0)
+            fprintf(out, "line %#llx %d\n", (unsigned long long)sm->phys[i], sm->slice[i]);
+    fclose(out);
+    return 0;
+}
+
+/* Look up the slice of a physical address in a table from write_slice_table */
+static int query_slice_table(const char *path, uint64_t phys) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    static struct slice_map sm;
+    memset(&sm, 0, sizeof(sm));
+    char line[4096];
+    int found = -1;
+    while (fgets(line, sizeof(line), in)) {
+        unsigned long long a, b;
+        int x, y;
+        if (strncmp(line, "cpus", 4) == 0) {
+            char *s = line + 4, *end;
+            while (sm.num_cpus < SLICE_MAX_CPUS) {
+                long c = strtol(s, &end, 10);
+                if (end == s) break;
+                sm.cpus[sm.num_cpus++] = (int)c;
+                s = end;
+            }
+        } else if (sscanf(line, "fn %llx", &a) == 1 && sm.num_fns < SLICE_MAX_FNS) {
+            sm.fns[sm.num_fns++] = a;
+        } else if (sscanf(line, "fixed %llx %llx", &a, &b) == 2) {
+            sm.fixed_mask = a;
+            sm.fixed_value = b;
+        } else if (sscanf(line, "code %d %d", &x, &y) == 2 && x >= 0 && x < (1 << SLICE_MAX_FNS)) {
+            sm.code_slice[x] = y;
+        } else if (sscanf(line, "slice %d %d", &x, &y) == 2 && x >= 0 && x < SLICE_MAX) {
+            sm.near_cpu[x] = y;
+            if (x >= sm.num_slices) sm.num_slices = x + 1;
+            int used = 0;
+            sscanf(line, "slice %*d %*d%n", &used);
+            char *s = line + used;
+            for (int c = 0; c < sm.num_cpus; c++) sm.slice_lat[x][c] = strtod(s, &s);
+        } else if (sscanf(line, "line %llx %d", &a, &x) == 2 && (a & ~63ULL) == (phys & ~63ULL)) {
+            found = x;
+        }
+    }
+    fclose(in);
+
+    int slice = sm.num_fns ? slice_of_phys(&sm, phys) : found;
+    if (slice < 0 || slice >= sm.num_slices) {
+        printf("%#llx: not in table and no hash was fitted\n", (unsigned long long)phys);
+        return -1;
+    }
+    printf("%#llx: slice %d (%s), nearest CPU %d\n", (unsigned long long)phys, slice,
+           sm.num_fns ? "hash" : "sampled line", sm.near_cpu[slice]);
+    if (sm.num_fns && (phys & sm.fixed_mask) != sm.fixed_value)
+        printf("  (outside the sampled physical range; the hash is extrapolated)\n");
+    for (int c = 0; c < sm.num_cpus; c++)
+        printf("  from CPU %d: %.1f ns\n", sm.cpus[c], sm.slice_lat[slice][c]);
+    return 0;
+}
+
+static void run_slice_map(const char *path) {
+    printf("=== L3 slices ===\n");
+    struct slice_map *sm = (struct slice_map *)malloc(sizeof(*sm));
+    if (!sm || probe_slice_map(sm) != 0) {
+        printf("Probe failed (buffer allocation)\n");
+        free(sm);
+        return;
+    }
+
+    printf("Labelled by %s over %d cores sharing the LLC\n",
+           sm->by_counters ? "C-box lookup counters" : "nearest core", sm->num_cpus);
+    if (!sm->by_counters && sm->num_cpus < 2)
+        printf("Only one core and no uncore counters: every line looks alike.\n");
+
+    printf("\nHit latency per slice (ns beyond an L1 hit)\n%6s %8s", "slice", "nearest");
+    for (int c = 0; c < sm->num_cpus; c++) printf(" %6s%-3d", "cpu", sm->cpus[c]);
+    printf("\n");
+    for (int s = 0; s < sm->num_slices; s++) {
+        printf("%6d %8d", s, sm->near_cpu[s]);
+        for (int c = 0; c < sm->num_cpus; c++) printf(" %9.1f", sm->slice_lat[s][c]);
+        printf("\n");
+    }
+
+    printf("\n");
+    if (sm->num_fns) {
+        printf("Linear slice hash (matches %.0f%% of labelled lines):\n", sm->agreement * 100.0);
+        for (int k = 0; k < sm->num_fns; k++) {
+            printf("  o%d = ", k);
+            print_mask_bits(sm->fns[k]);
+            printf("\n");
+        }
+    } else if (sm->num_slices > 1) {
+        printf("No linear hash fits (non-power-of-two slices, hidden PFNs or noisy labels);\n"
+               "the table lists sampled lines only.\n");
+    }
+
+    if (path) {
+        if (write_slice_table(sm, path) == 0)
+            printf("Slice table written to %s (query: slice %s <physical address>)\n", path, path);
+        else
+            printf("Cannot write %s\n", path);
+    }
+    free(sm);
+}
+
+int main(int argc, char **argv) {
+    calibrate_timer();
+
+    const char *mode = argc > 1 ? argv[1] : "dram";
+    if (strcmp(mode, "dram") == 0) {
+        run_dram_map();
+    } else if (strcmp(mode, "slices") == 0) {
+        run_slice_map(argc > 2 ? argv[2] : NULL);
+    } else if (strcmp(mode, "slice") == 0 && argc > 3) {
+        return query_slice_table(argv[2], strtoull(argv[3], NULL, 0)) != 0;
+    } else {
+        printf("Usage: %s [dram | slices [file] | slice <file> <physical address>]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
@@ -3,10 +3,15 @@
  * Detects page size and TLB size using timing-based probing
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
 
 /* High-resolution timing */
 #if defined(__x86_64__) || defined(__i386__)
@@ -39,177 +44,1093 @@ static inline void memory_barrier(void) {
 #endif
 }
 
+static double ticks_per_ns = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+#ifndef MFD_HUGE_SHIFT
+#define MFD_HUGE_SHIFT 26
+#endif
+
+/* Largest virtual span a probe region may reserve */
+#define MAX_SPAN ((size_t)1 << 45)
+/* hugetlbfs regions cost up to two mappings per page; stay under vm.max_map_count */
+#define MAX_ALIAS_PAGES 16384
+/* Minimum accesses per timed chase */
+#define CHASE_ACCESSES (1 << 20)
+
+/* How the pages of a probe region are backed */
+enum page_backing {
+    BACKING_ZERO,       /* base pages, all mapped to the zero page */
+    BACKING_THP,        /* transparent huge pages, mapped to the huge zero page */
+    BACKING_HUGETLB     /* one hugetlbfs page aliased into every slot */
+};
+
+struct page_kind {
+    size_t page_size;
+    enum page_backing backing;
+};
+
+struct page_region {
+    char *raw;          /* reservation as returned by mmap */
+    size_t raw_bytes;
+    char *base;         /* raw aligned up to the page size */
+};
+
+/*
+ * Map num_pages pages spaced `spacing` pages apart. The region is read-only:
+ * on Linux base-page and THP read faults map the (huge) zero page, and the
+ * hugetlbfs backing maps the same physical page into every slot. Either way
+ * the data stays in one L1-resident page however many pages are touched,
+ * so only address translation cost varies.
+ */
+static int map_region(const struct page_kind *kind, size_t num_pages,
+                      size_t spacing, struct page_region *r) {
+    size_t ps = kind->page_size;
+    size_t bytes = num_pages * spacing * ps;
+    if (bytes > MAX_SPAN) return -1;
+    if (kind->backing == BACKING_HUGETLB && num_pages > MAX_ALIAS_PAGES) return -1;
+
+    r->raw_bytes = bytes + ps;
+    void *p = mmap(NULL, r->raw_bytes, PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    r->raw = (char *)p;
+    r->base = (char *)(((uintptr_t)p + ps - 1) & ~(uintptr_t)(ps - 1));
+
+    if (kind->backing == BACKING_ZERO) {
+#ifdef MADV_NOHUGEPAGE
+        madvise(r->base, bytes, MADV_NOHUGEPAGE);
+#endif
+        return 0;
+    }
+    if (kind->backing == BACKING_THP) {
+#ifdef MADV_HUGEPAGE
+        madvise(r->base, bytes, MADV_HUGEPAGE);
+#endif
+        return 0;
+    }
+
+#if defined(__linux__) && defined(MFD_HUGETLB)
+    unsigned int shift = 0;
+    while (((size_t)1 << shift) < ps) shift++;
+    int fd = memfd_create("tlb_probe", MFD_HUGETLB | (shift << MFD_HUGE_SHIFT));
+    if (fd >= 0 && ftruncate(fd, (off_t)ps) == 0) {
+        size_t k;
+        for (k = 0; k < num_pages; k++) {
+            void *slot = r->base + k * spacing * ps;
+            if (mmap(slot, ps, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+                break;
+        }
+        close(fd);
+        if (k == num_pages) return 0;
+    } else if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    munmap(r->raw, r->raw_bytes);
+    return -1;
+}
+
+static void unmap_region(struct page_region *r) {
+    munmap(r->raw, r->raw_bytes);
+}
+
+/*
+ * Point at one line in each of num_pages pages. The line rotates with the
+ * page so the touched lines don't all share one cache set.
+ */
+static void fill_page_ptrs(const char **ptrs, const char *base, size_t page_size,
+                           size_t num_pages, size_t spacing) {
+    for (size_t i = 0; i < num_pages; i++) {
+        ptrs[i] = base + i * spacing * page_size + (i % 64) * 64;
+    }
+}
+
+/* Fisher-Yates shuffle */
+static void shuffle_ptrs(const char **ptrs, size_t n) {
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        const char *tmp = ptrs[i]; ptrs[i] = ptrs[j]; ptrs[j] = tmp;
+    }
+}
+
 /*
- * Detect page size via stride access
- * When stride >= page_size, each access touches a new page
- * causing potential TLB activity changes
+ * Time one access through each pointer, in order. Each load returns 0 and
+ * is added into the next address, so the loads serialize exactly like a
+ * pointer chase. Returns nanoseconds per access (best of ITERATIONS).
  */
-size_t probe_page_size(void) {
-    const size_t ARRAY_SIZE = 128 * 1024 * 1024;  /* 128MB */
+static double time_chase(const char **ptrs, size_t n, size_t min_accesses) {
     const int ITERATIONS = 3;
 
-    volatile char *array = (volatile char *)malloc(ARRAY_SIZE);
-    if (!array) return 4096;
+    /* Warm up: fault in the translations */
+    size_t v = 0;
+    for (size_t i = 0; i < n; i++) {
+        v = *(const size_t *)(ptrs[i] + v);
+    }
+
+    size_t accesses = n * 8;
+    if (accesses < min_accesses) accesses = min_accesses;
+    size_t reps = accesses / n;
+
+    double best = -1.0;
+    for (int iter = 0; iter < ITERATIONS; iter++) {
+        memory_barrier();
+        uint64_t start = get_time();
+        memory_barrier();
+
+        for (size_t r = 0; r < reps; r++) {
+            for (size_t i = 0; i < n; i++) {
+                v = *(const size_t *)(ptrs[i] + v);
+            }
+        }
+
+        memory_barrier();
+        uint64_t end = get_time();
+        double ns = (double)(end - start) / ticks_per_ns / (reps * n);
+        if (best < 0 || ns < best) best = ns;
+    }
+
+    volatile size_t dummy = v; (void)dummy;
+    return best;
+}
+
+/* Time num_pages pages of a mapped region, visited in random order */
+static double time_page_walk(const char *base, size_t page_size,
+                             size_t num_pages, size_t spacing) {
+    const char **ptrs = (const char **)malloc(num_pages * sizeof(*ptrs));
+    if (!ptrs) return -1.0;
+    fill_page_ptrs(ptrs, base, page_size, num_pages, spacing);
+    shuffle_ptrs(ptrs, num_pages);
+    double ns = time_chase(ptrs, num_pages, CHASE_ACCESSES);
+    free(ptrs);
+    return ns;
+}
+
+/* Map a fresh region, time num_pages pages in it, and release it */
+static double time_pages(const struct page_kind *kind, size_t num_pages, size_t spacing) {
+    struct page_region r;
+    if (map_region(kind, num_pages, spacing, &r) != 0) return -1.0;
+    double ns = time_page_walk(r.base, kind->page_size, num_pages, spacing);
+    unmap_region(&r);
+    return ns;
+}
+
+#define MAX_HUGE_SIZES 4
+
+/* Page sizes the system offers */
+struct page_sizes {
+    size_t base;                        /* sysconf(_SC_PAGESIZE) */
+    int num_huge;
+    size_t huge[MAX_HUGE_SIZES];        /* hugetlbfs sizes, ascending */
+    long huge_free[MAX_HUGE_SIZES];
+    size_t thp;                         /* THP size, 0 if THP is off */
+    char thp_mode[16];                  /* always / madvise / never */
+    double confirm_ratio;               /* timing check, > 1.15 confirms base */
+};
+
+/* How one mapping is backed, from /proc/self/smaps */
+struct smaps_info {
+    size_t kernel_page;                 /* KernelPageSize */
+    size_t mmu_page;                    /* MMUPageSize */
+    size_t rss;
+    size_t anon_huge;                   /* AnonHugePages */
+    int thp_eligible;
+};
+
+/* Read a single integer from a sysfs/procfs file, -1 if unavailable */
+static long read_sys_long(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    long v = -1;
+    if (fscanf(f, "%ld", &v) != 1) v = -1;
+    fclose(f);
+    return v;
+}
+
+/* Look up the smaps entry of the mapping containing addr */
+static int read_smaps(const void *addr, struct smaps_info *si) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+
+    char line[256];
+    int found = 0;
+    memset(si, 0, sizeof(*si));
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        size_t kb;
+        /* Field lines start with "Name:", mapping headers with "start-end" */
+        char *sp = strchr(line, ' ');
+        int is_field = sp && sp > line && sp[-1] == ':';
+        if (!is_field && sscanf(line, "%lx-%lx", &start, &end) == 2) {
+            if (found) break;
+            found = (uintptr_t)addr >= start && (uintptr_t)addr < end;
+        } else if (!found) {
+            continue;
+        } else if (sscanf(line, "KernelPageSize: %zu kB", &kb) == 1) {
+            si->kernel_page = kb * 1024;
+        } else if (sscanf(line, "MMUPageSize: %zu kB", &kb) == 1) {
+            si->mmu_page = kb * 1024;
+        } else if (sscanf(line, "Rss: %zu kB", &kb) == 1) {
+            si->rss = kb * 1024;
+        } else if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            si->anon_huge = kb * 1024;
+        } else if (sscanf(line, "THPeligible: %d", &si->thp_eligible) == 1) {
+            continue;
+        }
+    }
+    fclose(f);
+    return found ? 0 : -1;
+}
 
-    /* Touch all pages to ensure they're mapped */
-    for (size_t i = 0; i < ARRAY_SIZE; i += 4096) {
-        array[i] = (char)i;
+/*
+ * Timing check of the base page size: a chase with a line every page/2
+ * bytes spans half as many pages as one with a line every page, so once
+ * the larger page count overflows the first TLB level the full stride is
+ * measurably slower. If pages were really larger both would be equal.
+ * Runs in about a millisecond.
+ */
+static double confirm_page_size(size_t page_size) {
+    const size_t MAX_LINES = 256;
+    const size_t SHORT_CHASE = 1 << 14;
+    struct page_kind kind = {page_size, BACKING_ZERO};
+    struct page_region r;
+    const char *full[256], *half[256];
+    double best = 0.0;
+
+    if (map_region(&kind, MAX_LINES, 1, &r) != 0) return 0.0;
+    srand(54321);
+    for (size_t n = 64; n <= MAX_LINES; n *= 2) {
+        for (size_t i = 0; i < n; i++) {
+            full[i] = r.base + i * page_size + (i % 32) * 64;
+            half[i] = r.base + i * (page_size / 2) + (i % 32) * 64;
+        }
+        shuffle_ptrs(full, n);
+        shuffle_ptrs(half, n);
+        double ratio = time_chase(full, n, SHORT_CHASE) / time_chase(half, n, SHORT_CHASE);
+        if (ratio > best) best = ratio;
     }
+    unmap_region(&r);
+    return best;
+}
 
-    size_t strides[] = {512, 1024, 2048, 4096, 8192, 16384};
-    int num_strides = sizeof(strides) / sizeof(strides[0]);
-    double times[8];
+/*
+ * Detect page sizes from the OS rather than from timing: the base size
+ * from sysconf, hugetlbfs sizes from /sys/kernel/mm/hugepages and the THP
+ * size from hpage_pmd_size, followed by a short timing confirmation of
+ * the base size. Returns the base page size.
+ */
+size_t probe_page_size(struct page_sizes *ps) {
+    memset(ps, 0, sizeof(*ps));
+    long base = sysconf(_SC_PAGESIZE);
+    ps->base = base > 0 ? (size_t)base : 4096;
 
-    for (int s = 0; s < num_strides; s++) {
-        size_t stride = strides[s];
-        size_t num_accesses = ARRAY_SIZE / stride;
-        volatile char sum = 0;
-        uint64_t total_time = 0;
+    DIR *dir = opendir("/sys/kernel/mm/hugepages");
+    if (dir) {
+        struct dirent *de;
+        while ((de = readdir(dir)) && ps->num_huge < MAX_HUGE_SIZES) {
+            size_t kb;
+            if (sscanf(de->d_name, "hugepages-%zukB", &kb) != 1) continue;
 
-        for (int iter = 0; iter < ITERATIONS; iter++) {
-            memory_barrier();
-            uint64_t start = get_time();
-            memory_barrier();
+            char path[320];
+            snprintf(path, sizeof(path),
+                     "/sys/kernel/mm/hugepages/%s/free_hugepages", de->d_name);
+            int i = ps->num_huge++;
+            while (i > 0 && ps->huge[i-1] > kb * 1024) {
+                ps->huge[i] = ps->huge[i-1];
+                ps->huge_free[i] = ps->huge_free[i-1];
+                i--;
+            }
+            ps->huge[i] = kb * 1024;
+            ps->huge_free[i] = read_sys_long(path);
+        }
+        closedir(dir);
+    }
 
-            for (size_t i = 0; i < num_accesses; i++) {
-                sum += array[i * stride];
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f) {
+        char mode[64] = "";
+        if (fgets(mode, sizeof(mode), f)) {
+            char *open = strchr(mode, '['), *close = strchr(mode, ']');
+            if (open && close && close > open &&
+                (size_t)(close - open) <= sizeof(ps->thp_mode)) {
+                memcpy(ps->thp_mode, open + 1, close - open - 1);
             }
+        }
+        fclose(f);
+    }
+    if (ps->thp_mode[0] && strcmp(ps->thp_mode, "never") != 0) {
+        long pmd = read_sys_long("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        ps->thp = pmd > 0 ? (size_t)pmd : 0;
+    }
+
+    ps->confirm_ratio = confirm_page_size(ps->base);
+    return ps->base;
+}
+
+/* Pick a backing for a huge page size: hugetlbfs if a page is free, else THP */
+static int choose_backing(const struct page_sizes *ps, size_t page_size,
+                          enum page_backing *backing) {
+    for (int i = 0; i < ps->num_huge; i++) {
+        if (ps->huge[i] == page_size && ps->huge_free[i] > 0) {
+            *backing = BACKING_HUGETLB;
+            return 1;
+        }
+    }
+
+    /* The huge zero page only backs THP-sized read faults */
+    if (ps->thp != page_size) return 0;
+    if (read_sys_long("/sys/kernel/mm/transparent_hugepage/use_zero_page") != 1) return 0;
+
+    *backing = BACKING_THP;
+    return 1;
+}
+
+/* Map a small region of this kind, touch it, and report what smaps sees */
+static void print_region_pages(const struct page_kind *kind) {
+    struct page_region r;
+    struct smaps_info si;
+    if (map_region(kind, 4, 1, &r) != 0) return;
+
+    volatile char sum = 0;
+    for (size_t i = 0; i < 4; i++) sum += r.base[i * kind->page_size];
+    (void)sum;
 
-            memory_barrier();
-            uint64_t end = get_time();
-            total_time += (end - start);
+    if (read_smaps(r.base, &si) == 0) {
+        printf("smaps:       KernelPageSize %zu KB, MMUPageSize %zu KB, AnonHugePages %zu KB%s\n",
+               si.kernel_page / 1024, si.mmu_page / 1024, si.anon_huge / 1024,
+               si.thp_eligible ? ", THP eligible" : "");
+        if (kind->backing == BACKING_THP)
+            printf("             (the huge zero page is not counted in smaps)\n");
+    }
+    unmap_region(&r);
+}
+
+#define MAX_TLB_LEVELS 4
+#define MAX_TLB_POINTS 96
+
+struct tlb_point {
+    size_t pages;
+    double ns;
+};
+
+struct tlb_level {
+    size_t entries;     /* pages covered before latency steps up */
+    double hit_ns;      /* latency per access while this level hits */
+};
+
+struct tlb_info {
+    int num_levels;
+    struct tlb_level levels[MAX_TLB_LEVELS];
+    double miss_ns;             /* latency once the last level misses */
+    double walk_ns[4];          /* walk cost with PTEs in L1/L2/L3/DRAM, <0 if n/a */
+    size_t walk_bytes[4];       /* PTE working set of each walk test */
+    size_t walk_min[4];         /* working set the tier needs to exceed */
+    double pwc_miss_ns;         /* extra cost when paging-structure caches miss */
+};
+
+/*
+ * Sweep 4..max_pages pages on a coarse grid (powers of two and 1.5x),
+ * then bisect every interval where latency jumps so knees are located
+ * to within a few percent. Returns the number of points.
+ */
+static int sweep_tlb(const char *base, size_t page_size, size_t spacing,
+                     size_t max_pages, struct tlb_point *pts) {
+    int n = 0;
+    for (size_t p = 4; p <= max_pages; p *= 2) {
+        pts[n].pages = p;
+        pts[n].ns = time_page_walk(base, page_size, p, spacing);
+        n++;
+        if (p * 3 / 2 <= max_pages) {
+            pts[n].pages = p * 3 / 2;
+            pts[n].ns = time_page_walk(base, page_size, p * 3 / 2, spacing);
+            n++;
         }
+    }
 
-        times[s] = (double)total_time / (ITERATIONS * num_accesses);
-        (void)sum;
+    for (int pass = 0; pass < 4; pass++) {
+        for (int i = 1; i < n && n < MAX_TLB_POINTS; i++) {
+            size_t lo = pts[i-1].pages, hi = pts[i].pages;
+            if (pts[i].ns > pts[i-1].ns * 1.10 && hi - lo > lo / 16 + 1) {
+                memmove(&pts[i+1], &pts[i], (n - i) * sizeof(pts[0]));
+                pts[i].pages = lo + (hi - lo) / 2;
+                pts[i].ns = time_page_walk(base, page_size, pts[i].pages, spacing);
+                n++;
+                i++;
+            }
+        }
     }
+    return n;
+}
+
+/*
+ * Index of the first point from i on where a plateau starts: latency at
+ * 2x the pages is within 10% of it. -1 if none.
+ */
+static int next_plateau(const struct tlb_point *pts, int n, int i) {
+    for (; i < n; i++) {
+        int m = i;
+        while (m + 1 < n && pts[m+1].pages <= 2 * pts[i].pages) m++;
+        if (m + 1 >= n) return -1;
+        if (pts[m].ns <= pts[i].ns * 1.10) return i;
+    }
+    return -1;
+}
+
+/*
+ * Find latency knees: a knee is the last point before latency rises 15%
+ * above the current plateau and stays there. After a knee, skip the ramp to where the
+ * curve is flat for at least 2x in pages and take that as the next
+ * plateau; once page walks dominate the curve keeps rising and no
+ * further plateau is found.
+ */
+static int find_knees(const struct tlb_point *pts, int n,
+                      struct tlb_level *knees, int max_knees) {
+    int k = 0;
+    double base = pts[0].ns;
+    for (int i = 1; i < n; i++) {
+        /* Two points in a row above the plateau, so one noisy sample isn't a knee */
+        if (pts[i].ns > base * 1.15 && (i + 1 == n || pts[i+1].ns > base * 1.15)) {
+            if (k < max_knees) {
+                knees[k].entries = pts[i-1].pages;
+                knees[k].hit_ns = base;
+                k++;
+            }
+            i = next_plateau(pts, n, i);
+            if (i < 0) break;
+            base = pts[i].ns;
+        } else if (pts[i].ns < base) {
+            base = pts[i].ns;
+        }
+    }
+    return k;
+}
+
+/* Data cache sizes used to size page-table working sets */
+static size_t data_cache_size(int level) {
+    static const size_t defaults[] = {0, 32*1024, 1024*1024, 32*1024*1024};
+    long v = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    if (level == 1) v = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    else if (level == 2) v = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    else if (level == 3) v = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    return v > 0 ? (size_t)v : defaults[level];
+}
+
+static size_t physical_memory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (size_t)pages * page_size;
+    return (size_t)4 * 1024 * 1024 * 1024;
+}
+
+/* Cap a page count so its region fits the span and mapping limits */
+static size_t cap_pages(const struct page_kind *kind, size_t pages, size_t spacing) {
+    size_t max = MAX_SPAN / (spacing * kind->page_size);
+    if (kind->backing == BACKING_HUGETLB && max > MAX_ALIAS_PAGES) max = MAX_ALIAS_PAGES;
+    return pages < max ? pages : max;
+}
+
+/*
+ * Detect the TLB hierarchy for one page size via a pointer chase over up
+ * to 64K pages (fewer for huge pages, where the virtual span runs out).
+ * The sweep is run with pages adjacent (8 bytes of PTE per page) and 3
+ * pages apart (24 bytes per page): TLB capacity knees sit at the same page
+ * count and latency in both, while knees caused by the page tables
+ * spilling out of a data cache shift, so only common knees are reported
+ * as levels. Walk cost
+ * is then measured with the PTE working set sized to land in each cache
+ * level.
+ */
+int probe_tlb_size(const struct page_kind *kind, struct tlb_info *info) {
+    size_t page_size = kind->page_size;
+    size_t max_pages = cap_pages(kind, 64 * 1024, 3);
+
+    struct tlb_point dense[MAX_TLB_POINTS], sparse[MAX_TLB_POINTS];
+    struct tlb_level dense_knees[8], sparse_knees[8];
+    struct page_region r;
+
+    memset(info, 0, sizeof(*info));
+    srand(54321);
 
-    /* Find where normalized time levels off (similar to cache line detection) */
-    size_t detected = 4096;
-    for (int s = 2; s < num_strides; s++) {
-        double ratio = times[s] / times[s-1];
-        if (ratio < 0.6) {  /* Time per access drops when stride >= page */
-            detected = strides[s-1];
+    if (map_region(kind, max_pages, 1, &r) != 0) return 0;
+    int nd = sweep_tlb(r.base, page_size, 1, max_pages, dense);
+    unmap_region(&r);
+    if (map_region(kind, max_pages, 3, &r) != 0) return 0;
+    int ns = sweep_tlb(r.base, page_size, 3, max_pages, sparse);
+    unmap_region(&r);
+
+    int kd = find_knees(dense, nd, dense_knees, 8);
+    int ks = find_knees(sparse, ns, sparse_knees, 8);
+
+    for (int i = 0; i < kd && info->num_levels < MAX_TLB_LEVELS; i++) {
+        for (int j = 0; j < ks; j++) {
+            double ratio = (double)dense_knees[i].entries / sparse_knees[j].entries;
+            if (ratio < 0.5 || ratio > 2.0) continue;
+            /* While a level still hits there are no walks, so both agree */
+            double hit_ratio = dense_knees[i].hit_ns / sparse_knees[j].hit_ns;
+            if (hit_ratio < 0.9 || hit_ratio > 1.1) continue;
+            /* Knees closer than 1.5x are one level's ramp, keep the last */
+            struct tlb_level *prev = info->num_levels > 0 ?
+                &info->levels[info->num_levels - 1] : NULL;
+            if (prev && dense_knees[i].entries <= prev->entries * 3 / 2)
+                prev->entries = dense_knees[i].entries;
+            else
+                info->levels[info->num_levels++] = dense_knees[i];
             break;
         }
     }
+    if (info->num_levels == 0) return 0;
+
+    /* Latency just past the last level, before page tables leave L1 */
+    size_t last = info->levels[info->num_levels - 1].entries;
+    double last_hit = info->levels[info->num_levels - 1].hit_ns;
+    info->miss_ns = time_pages(kind, 2 * last, 1);
 
-    free((void *)array);
-    return detected;
+    /* Walk cost with the PTE working set in L1, L2, L3 and DRAM */
+    size_t l1 = data_cache_size(1), l2 = data_cache_size(2), l3 = data_cache_size(3);
+    size_t lower[4] = {0, l1, l2, 2 * l3};
+    size_t upper[4] = {l1, l2, l3, (size_t)-1};
+    size_t target[4] = {16 * last, l2 / 2, l3 / 2, 4 * l3};
+
+    for (int t = 0; t < 4; t++) {
+        size_t pte_bytes = t == 0 ? 8 : 64;
+        size_t spacing = t == 0 ? 1 : 9;
+        size_t pages = target[t] / pte_bytes;
+        if (pages < 2 * last) pages = 2 * last;
+        /* Page tables cost 8 bytes per spanned page, the chase 8 per page */
+        size_t max_walk = physical_memory() / 4 / (8 * spacing + 8);
+        if (pages > max_walk) pages = max_walk;
+        pages = cap_pages(kind, pages, spacing);
+
+        info->walk_bytes[t] = pages * pte_bytes;
+        info->walk_min[t] = lower[t];
+        info->walk_ns[t] = -1.0;
+        if (pages < 2 * last) continue;
+        if (info->walk_bytes[t] <= lower[t] || info->walk_bytes[t] > upper[t]) continue;
+
+        double lat = time_pages(kind, pages, spacing);
+        if (lat > 0) info->walk_ns[t] = lat - last_hit;
+    }
+
+    /* Every page in its own 512-entry table defeats the upper-level paging caches */
+    double near = time_pages(kind, 2 * last, 9);
+    double far = time_pages(kind, 2 * last, 512);
+    info->pwc_miss_ns = (near > 0 && far > 0) ? far - near : -1.0;
+
+    return info->num_levels;
 }
 
 /*
- * Detect TLB size via page-stride pointer chase
- * Access N pages in random order; when N > TLB entries, TLB misses occur
+ * Decide whether large pages share the last TLB level with base pages by
+ * chasing 3/4 of each one's capacity, shuffled together. With separate
+ * arrays both sets still fit and latency stays at the weighted average of
+ * the two alone; a shared array overflows and the mix misses.
+ * Returns mixed/expected latency, or <0 if it could not be measured.
  */
-int probe_tlb_size(size_t page_size) {
-    const int ITERATIONS = 5;
-    const size_t MAX_PAGES = 4096;
-    const size_t ARRAY_SIZE = MAX_PAGES * page_size;
+static double probe_stlb_sharing(const struct page_kind *small, const struct tlb_info *si,
+                                 const struct page_kind *large, const struct tlb_info *li) {
+    if (si->num_levels < 2 || li->num_levels < 2) return -1.0;
 
-    char *array = (char *)malloc(ARRAY_SIZE);
-    if (!array) return 64;
+    size_t ns = si->levels[si->num_levels - 1].entries * 3 / 4;
+    size_t nl = li->levels[li->num_levels - 1].entries * 3 / 4;
+    struct page_region rs, rl;
+    if (map_region(small, ns, 1, &rs) != 0) return -1.0;
+    if (map_region(large, nl, 1, &rl) != 0) {
+        unmap_region(&rs);
+        return -1.0;
+    }
 
-    /* Initialize all pages */
-    for (size_t i = 0; i < ARRAY_SIZE; i += page_size) {
-        array[i] = 0;
+    double ratio = -1.0;
+    const char **ptrs = (const char **)malloc((ns + nl) * sizeof(*ptrs));
+    if (ptrs) {
+        double small_ns = time_page_walk(rs.base, small->page_size, ns, 1);
+        double large_ns = time_page_walk(rl.base, large->page_size, nl, 1);
+
+        fill_page_ptrs(ptrs, rs.base, small->page_size, ns, 1);
+        fill_page_ptrs(ptrs + ns, rl.base, large->page_size, nl, 1);
+        shuffle_ptrs(ptrs, ns + nl);
+        double mixed_ns = time_chase(ptrs, ns + nl, CHASE_ACCESSES);
+
+        double expected = (small_ns * ns + large_ns * nl) / (ns + nl);
+        ratio = mixed_ns / expected;
+        free(ptrs);
     }
 
-    int pages_to_test[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
-    int num_tests = sizeof(pages_to_test) / sizeof(pages_to_test[0]);
-    double times[12];
+    unmap_region(&rs);
+    unmap_region(&rl);
+    return ratio;
+}
+
+static void print_bytes(size_t bytes) {
+    if (bytes >= 1024*1024*1024)
+        printf("%zu GB", bytes / (1024*1024*1024));
+    else if (bytes >= 1024*1024)
+        printf("%zu MB", bytes / (1024*1024));
+    else
+        printf("%zu KB", bytes / 1024);
+}
+
+#define NUM_STRIDES 10      /* page strides 1, 2, 4, ... 512 */
 
+struct tlb_assoc {
+    size_t probe_pages;         /* page count held fixed across strides */
+    double stride_ns[NUM_STRIDES];
+    size_t onset_stride;        /* first stride that thrashes, 0 if none */
+    size_t ways;                /* pages one set holds, 0 if never thrashed */
+    size_t sets;
+    int index_bits;
+    size_t expected_stride;     /* onset predicted by low-bit set indexing */
+};
+
+/*
+ * Detect the associativity of one TLB level by holding the page count at a
+ * quarter of its capacity and doubling the page stride. A stride of 2^k
+ * pages confines the pages to 1/2^k of the sets under low-bit indexing, so
+ * capacity shrinks to max(ways, entries / 2^k) and the level starts to
+ * thrash once that falls below the page count. At the largest stride all
+ * pages share one set, and a page-count search there gives the ways.
+ */
+int probe_tlb_assoc(const struct page_kind *kind, const struct tlb_info *info,
+                    int level, struct tlb_assoc *assoc) {
+    memset(assoc, 0, sizeof(*assoc));
+    if (level >= info->num_levels) return -1;
+
+    size_t entries = info->levels[level].entries;
+    double hit = info->levels[level].hit_ns;
+    double next = level + 1 < info->num_levels ?
+        info->levels[level + 1].hit_ns : info->miss_ns;
+    double threshold = hit + (next - hit) / 2;
+
+    assoc->probe_pages = entries / 4 < 2 ? 2 : entries / 4;
     srand(54321);
 
-    for (int t = 0; t < num_tests; t++) {
-        int num_pages = pages_to_test[t];
-        if ((size_t)num_pages > MAX_PAGES) break;
+    for (int k = 0; k < NUM_STRIDES; k++) {
+        size_t stride = (size_t)1 << k;
+        assoc->stride_ns[k] = time_pages(kind, assoc->probe_pages, stride);
+        if (assoc->onset_stride == 0 && assoc->stride_ns[k] > threshold)
+            assoc->onset_stride = stride;
+    }
+    if (assoc->onset_stride == 0) return 0;
+
+    /* Largest page count that still fits at the largest stride */
+    size_t max_stride = (size_t)1 << (NUM_STRIDES - 1);
+    size_t lo = 1, hi = assoc->probe_pages;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (time_pages(kind, mid, max_stride) > threshold)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    assoc->ways = lo;
 
-        /* Create random order of pages */
-        size_t *order = (size_t *)malloc(num_pages * sizeof(size_t));
-        for (int i = 0; i < num_pages; i++) order[i] = i;
+    /* Round entries / ways to the nearest power of two */
+    while (((size_t)3 << assoc->index_bits) < 2 * (entries / assoc->ways)) assoc->index_bits++;
+    assoc->sets = (size_t)1 << assoc->index_bits;
 
-        /* Fisher-Yates shuffle */
-        for (int i = num_pages - 1; i > 0; i--) {
-            int j = rand() % (i + 1);
-            size_t tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    for (int k = 0; k < NUM_STRIDES; k++) {
+        size_t stride = (size_t)1 << k;
+        size_t capacity = entries / stride > assoc->ways ? entries / stride : assoc->ways;
+        if (capacity < assoc->probe_pages) {
+            assoc->expected_stride = stride;
+            break;
         }
+    }
+    return 0;
+}
+
+static void print_tlb_assoc(const struct page_kind *kind, const struct tlb_info *info,
+                            int level, const struct tlb_assoc *assoc) {
+    size_t page_size = kind->page_size;
+    int page_shift = 0;
+    while (((size_t)1 << page_shift) < page_size) page_shift++;
+
+    printf("TLB Level %d (%zu entries), %zu pages per stride:\n",
+           level + 1, info->levels[level].entries, assoc->probe_pages);
+    for (int k = 0; k < NUM_STRIDES; k++) {
+        size_t stride = (size_t)1 << k;
+        printf("  stride %3zu pages: %6.2f ns%s\n", stride, assoc->stride_ns[k],
+               assoc->onset_stride && stride >= assoc->onset_stride ? "  (thrashing)" : "");
+    }
+
+    if (assoc->onset_stride == 0) {
+        printf("  No set conflicts up to %zu-page strides: fully associative, "
+               "hashed set index, or >= %zu ways\n",
+               (size_t)1 << (NUM_STRIDES - 1), assoc->probe_pages);
+        return;
+    }
+
+    printf("  Associativity: %zu-way, %zu sets\n", assoc->ways, assoc->sets);
+    if (assoc->expected_stride == assoc->onset_stride) {
+        printf("  Indexing:      virtual address bits %d-%d (linear)\n",
+               page_shift, page_shift + assoc->index_bits - 1);
+        printf("  Avoid:         strides that are multiples of %zu pages (",
+               assoc->sets);
+        print_bytes(assoc->sets * page_size);
+        printf(") hold only %zu entries\n", assoc->ways);
+    } else {
+        printf("  Indexing:      non-linear (thrashes at stride %zu, low-bit indexing predicts %zu)\n",
+               assoc->onset_stride, assoc->expected_stride);
+        printf("  Avoid:         strides of %zu pages and above\n", assoc->onset_stride);
+    }
+}
+
+static void print_tlb_info(const struct page_kind *kind, const struct tlb_info *info) {
+    size_t page_size = kind->page_size;
+    if (info->num_levels == 0) {
+        printf("TLB:         no capacity knee found\n");
+        return;
+    }
+
+    for (int i = 0; i < info->num_levels; i++) {
+        printf("TLB Level %d: %6zu entries (", i + 1, info->levels[i].entries);
+        print_bytes(info->levels[i].entries * page_size);
+        printf(" reach), hit %.2f ns", info->levels[i].hit_ns);
+        if (i > 0)
+            printf(" (+%.2f ns)", info->levels[i].hit_ns - info->levels[i-1].hit_ns);
+        printf("\n");
+    }
+    printf("TLB Miss:    %.2f ns per access\n", info->miss_ns);
+
+    const char *tiers[4] = {"L1", "L2", "L3", "DRAM"};
+    for (int t = 0; t < 4; t++) {
+        printf("Page Walk (PTEs in %-4s): ", tiers[t]);
+        if (info->walk_ns[t] < 0 && info->walk_bytes[t] <= info->walk_min[t]) {
+            printf("n/a  [PTE working set capped at ");
+            print_bytes(info->walk_bytes[t]);
+            printf(", needs over ");
+            print_bytes(info->walk_min[t]);
+            printf("]\n");
+            continue;
+        }
+        if (info->walk_ns[t] < 0)
+            printf("n/a");
+        else
+            printf("%.2f ns", info->walk_ns[t]);
+        printf("  [PTE working set ");
+        print_bytes(info->walk_bytes[t]);
+        printf("]\n");
+    }
+    if (info->pwc_miss_ns >= 0)
+        printf("Paging-structure cache miss: +%.2f ns\n", info->pwc_miss_ns);
+}
+
+#define HEAT_ROWS 7         /* 1, 2, 4, ... 64 lines per page */
+#define HEAT_COLS 13        /* 16, 32, ... 64K pages */
 
-        /* Create pointer chase: page[i] -> page[i+1] in shuffled order */
-        for (int i = 0; i < num_pages - 1; i++) {
-            *(size_t *)(array + order[i] * page_size) = order[i + 1] * page_size;
+struct tlb_heatmap {
+    size_t lines[HEAT_ROWS];
+    size_t pages[HEAT_COLS];
+    double ns[HEAT_ROWS][HEAT_COLS];
+    size_t cache_bytes[8];          /* derived data cache capacities */
+    int num_caches;
+    size_t tlb_pages[8];            /* derived TLB reaches, in pages */
+    int num_tlbs;
+};
+
+/*
+ * Link `lines` lines in each of num_pages pages into one random cycle,
+ * the same way create_pointer_chase does for cache_info.c. The lines are
+ * spread evenly over the page, and rotate with the page so the pages
+ * don't all land in one cache set.
+ */
+static void *create_page_chase(char *buf, size_t page_size, size_t num_pages,
+                               size_t lines) {
+    size_t count = num_pages * lines;
+    size_t slot = page_size / lines;
+    char **nodes = (char **)malloc(count * sizeof(*nodes));
+    if (!nodes) return NULL;
+
+    for (size_t p = 0; p < num_pages; p++) {
+        for (size_t l = 0; l < lines; l++) {
+            nodes[p * lines + l] = buf + p * page_size + l * slot + (p % (slot / 64)) * 64;
         }
-        *(size_t *)(array + order[num_pages - 1] * page_size) = order[0] * page_size;
+    }
+    shuffle_ptrs((const char **)nodes, count);
+    for (size_t i = 0; i < count; i++) {
+        *(void **)nodes[i] = nodes[(i + 1) % count];
+    }
+
+    void *start = nodes[0];
+    free(nodes);
+    return start;
+}
+
+/* Time a chase through `count` linked lines, ns per access */
+static double time_page_chase(void *start, size_t count) {
+    const int ITERATIONS = 3;
+    size_t accesses = count * 2 < (1 << 20) ? (1 << 20) : count * 2;
+
+    void *p = start;
+    for (size_t i = 0; i < count; i++) p = *(void **)p;
+
+    double best = -1.0;
+    for (int iter = 0; iter < ITERATIONS; iter++) {
+        memory_barrier();
+        uint64_t t0 = get_time();
+        memory_barrier();
 
-        /* Warm up */
-        size_t idx = order[0] * page_size;
-        for (int i = 0; i < num_pages * 4; i++) {
-            idx = *(size_t *)(array + idx);
+        for (size_t a = 0; a < accesses; a++) p = *(void **)p;
+
+        memory_barrier();
+        uint64_t t1 = get_time();
+        double ns = (double)(t1 - t0) / ticks_per_ns / accesses;
+        if (best < 0 || ns < best) best = ns;
+    }
+
+    void *volatile dummy = p; (void)dummy;
+    return best;
+}
+
+/*
+ * Classify a heatmap knee. Cache capacity knees sit at the same footprint
+ * in every row, TLB knees at the same page count, so count the other rows
+ * that agree each way. Returns 1 for cache, 2 for TLB, 0 if undecided.
+ */
+static int classify_knee(const struct tlb_level knees[HEAT_ROWS][8], const int *nk,
+                         const struct tlb_heatmap *hm, int row, size_t pages) {
+    size_t bytes = pages * hm->lines[row] * 64;
+    int cache_votes = 0, tlb_votes = 0;
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        if (r == row) continue;
+        for (int k = 0; k < nk[r]; k++) {
+            double pr = (double)knees[r][k].entries / pages;
+            double br = (double)(knees[r][k].entries * hm->lines[r] * 64) / bytes;
+            if (pr > 0.7 && pr < 1.4) tlb_votes++;
+            if (br > 0.7 && br < 1.4) cache_votes++;
         }
+    }
+    if (cache_votes > tlb_votes) return 1;
+    if (tlb_votes > cache_votes) return 2;
+    return 0;
+}
 
-        /* Timed pointer chase */
-        uint64_t total_time = 0;
-        size_t accesses = (size_t)num_pages * 200;
+/* Add a value to a list unless one within 1.4x is already there */
+static int add_unique(size_t *list, int n, size_t value) {
+    for (int i = 0; i < n; i++) {
+        double r = (double)list[i] / value;
+        if (r > 0.7 && r < 1.4) return n;
+    }
+    if (n < 8) list[n++] = value;
+    return n;
+}
 
-        for (int iter = 0; iter < ITERATIONS; iter++) {
-            idx = order[0] * page_size;
-            memory_barrier();
-            uint64_t start = get_time();
-            memory_barrier();
+/*
+ * Sweep (pages touched) x (lines touched per page) with a pointer chase
+ * over real data, so cache and TLB effects show up in one surface. Along
+ * a row the footprint grows with the page count; down a column the page
+ * count is fixed while the footprint grows. Knees that keep their page
+ * count across rows are TLB reach, knees that keep their byte count are
+ * cache capacity.
+ */
+int probe_tlb_heatmap(size_t page_size, struct tlb_heatmap *hm) {
+    size_t max_pages = (size_t)16 << (HEAT_COLS - 1);
+    memset(hm, 0, sizeof(*hm));
 
-            for (size_t a = 0; a < accesses; a++) {
-                idx = *(size_t *)(array + idx);
-            }
+    void *p = mmap(NULL, max_pages * page_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    char *buf = (char *)p;
+#ifdef MADV_NOHUGEPAGE
+    madvise(buf, max_pages * page_size, MADV_NOHUGEPAGE);
+#endif
 
-            memory_barrier();
-            uint64_t end = get_time();
-            total_time += (end - start);
+    srand(12345);
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        hm->lines[r] = (size_t)1 << r;
+        for (int c = 0; c < HEAT_COLS; c++) {
+            hm->pages[c] = (size_t)16 << c;
+            void *start = create_page_chase(buf, page_size, hm->pages[c], hm->lines[r]);
+            hm->ns[r][c] = start ? time_page_chase(start, hm->pages[c] * hm->lines[r]) : -1.0;
         }
+    }
+    munmap(buf, max_pages * page_size);
 
-        volatile size_t dummy = idx; (void)dummy;
-        times[t] = (double)total_time / (ITERATIONS * accesses);
-        free(order);
+    struct tlb_level knees[HEAT_ROWS][8];
+    int nk[HEAT_ROWS];
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        struct tlb_point pts[HEAT_COLS];
+        for (int c = 0; c < HEAT_COLS; c++) {
+            pts[c].pages = hm->pages[c];
+            pts[c].ns = hm->ns[r][c];
+        }
+        nk[r] = find_knees(pts, HEAT_COLS, knees[r], 8);
     }
 
-    /* Find TLB size: where latency increases significantly */
-    int detected = 64;
-    for (int t = 1; t < num_tests; t++) {
-        double ratio = times[t] / times[t-1];
-        if (ratio > 1.25) {
-            detected = pages_to_test[t-1];
-            break;
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        for (int k = 0; k < nk[r]; k++) {
+            size_t pages = knees[r][k].entries;
+            int kind = classify_knee(knees, nk, hm, r, pages);
+            if (kind == 1)
+                hm->num_caches = add_unique(hm->cache_bytes, hm->num_caches,
+                                            pages * hm->lines[r] * 64);
+            else if (kind == 2)
+                hm->num_tlbs = add_unique(hm->tlb_pages, hm->num_tlbs, pages);
         }
     }
+    return 0;
+}
 
-    free(array);
-    return detected;
+static int compare_size(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
 }
 
-int main(void) {
-    size_t page_size = probe_page_size();
+/* Print the heatmap as a table, and also to `path` as TSV if given */
+static void print_tlb_heatmap(size_t page_size, struct tlb_heatmap *hm, const char *path) {
+    printf("=== TLB x cache heatmap (ns per access) ===\n");
+    printf("lines/page");
+    for (int c = 0; c < HEAT_COLS; c++) printf(" %7zu", hm->pages[c]);
+    printf("  (pages)\n");
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        printf("%10zu", hm->lines[r]);
+        for (int c = 0; c < HEAT_COLS; c++) printf(" %7.2f", hm->ns[r][c]);
+        printf("\n");
+    }
 
-    /* Run multiple trials and take most common result */
-    int results[10];
-    for (int i = 0; i < 10; i++) {
-        results[i] = probe_tlb_size(page_size);
+    qsort(hm->cache_bytes, hm->num_caches, sizeof(size_t), compare_size);
+    qsort(hm->tlb_pages, hm->num_tlbs, sizeof(size_t), compare_size);
+    printf("\nCache capacity:");
+    if (hm->num_caches == 0) printf(" none found");
+    for (int i = 0; i < hm->num_caches; i++) {
+        printf(i ? ", " : " ");
+        print_bytes(hm->cache_bytes[i]);
     }
+    printf("\nTLB reach:");
+    if (hm->num_tlbs == 0) printf(" none found");
+    for (int i = 0; i < hm->num_tlbs; i++) {
+        printf(i ? ", " : " ");
+        printf("%zu pages (", hm->tlb_pages[i]);
+        print_bytes(hm->tlb_pages[i] * page_size);
+        printf(")");
+    }
+    printf("\n(knees are the last point before a step, at the grid's 2x resolution)\n");
+
+    if (!path) return;
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "# lines_per_page");
+    for (int c = 0; c < HEAT_COLS; c++) fprintf(f, "\t%zu", hm->pages[c]);
+    fprintf(f, "\n");
+    for (int r = 0; r < HEAT_ROWS; r++) {
+        fprintf(f, "%zu", hm->lines[r]);
+        for (int c = 0; c < HEAT_COLS; c++) fprintf(f, "\t%.3f", hm->ns[r][c]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    printf("Heatmap written to %s\n", path);
+}
 
-    /* Find most frequent result */
-    int tlb_size = results[0];
-    int max_count = 1;
-    for (int i = 0; i < 10; i++) {
-        int count = 0;
-        for (int j = 0; j < 10; j++) {
-            if (results[j] == results[i]) count++;
+int main(int argc, char **argv) {
+    calibrate_timer();
+
+    struct page_sizes ps;
+    size_t page_size = probe_page_size(&ps);
+
+    /* tlb_info heatmap [file]: pages x lines-per-page latency surface */
+    if (argc > 1 && strcmp(argv[1], "heatmap") == 0) {
+        struct tlb_heatmap hm;
+        if (probe_tlb_heatmap(page_size, &hm) != 0) {
+            printf("Heatmap buffer allocation failed\n");
+            return 1;
         }
-        if (count > max_count) {
-            max_count = count;
-            tlb_size = results[i];
+        print_tlb_heatmap(page_size, &hm, argc > 2 ? argv[2] : NULL);
+        return 0;
+    }
+
+    printf("Page Size: %zu bytes (%zu KB), ", page_size, page_size / 1024);
+    if (ps.confirm_ratio > 1.15)
+        printf("confirmed by timing (%.2fx)\n", ps.confirm_ratio);
+    else
+        printf("not confirmed by timing (%.2fx)\n", ps.confirm_ratio);
+    printf("Huge Pages:");
+    if (ps.num_huge == 0) printf(" none");
+    for (int i = 0; i < ps.num_huge; i++) {
+        printf(i ? ", " : " ");
+        print_bytes(ps.huge[i]);
+        printf(" (%ld free)", ps.huge_free[i]);
+    }
+    printf("\nTHP:        ");
+    if (ps.thp) {
+        print_bytes(ps.thp);
+        printf(" (%s)\n", ps.thp_mode);
+    } else {
+        printf("off\n");
+    }
+
+    /* Base pages, every hugetlbfs size, and THP if its size isn't listed */
+    struct page_kind kinds[MAX_HUGE_SIZES + 2];
+    int num_kinds = 0;
+    kinds[num_kinds++] = (struct page_kind){page_size, BACKING_ZERO};
+    for (int i = 0; i < ps.num_huge; i++)
+        kinds[num_kinds++] = (struct page_kind){ps.huge[i], BACKING_HUGETLB};
+    int thp_listed = 0;
+    for (int i = 0; i < ps.num_huge; i++)
+        if (ps.huge[i] == ps.thp) thp_listed = 1;
+    if (ps.thp && !thp_listed)
+        kinds[num_kinds++] = (struct page_kind){ps.thp, BACKING_THP};
+
+    const char *backing_names[] = {"base pages", "THP", "hugetlbfs"};
+    struct tlb_info infos[MAX_HUGE_SIZES + 2];
+    int available[MAX_HUGE_SIZES + 2] = {1};
+
+    for (int k = 0; k < num_kinds; k++) {
+        if (k > 0) available[k] = choose_backing(&ps, kinds[k].page_size, &kinds[k].backing);
+
+        printf("\n=== ");
+        print_bytes(kinds[k].page_size);
+        printf(" pages ===\n");
+        memset(&infos[k], 0, sizeof(infos[k]));
+        if (!available[k]) {
+            printf("Not available (no free hugetlbfs pages");
+            if (kinds[k].page_size == ps.thp) printf(" or THP zero page");
+            printf(")\n");
+            continue;
         }
+        printf("Backing:     %s\n", backing_names[kinds[k].backing]);
+        print_region_pages(&kinds[k]);
+        probe_tlb_size(&kinds[k], &infos[k]);
+        print_tlb_info(&kinds[k], &infos[k]);
     }
 
-    printf("Page Size: %zu bytes (%zu KB)\n", page_size, page_size / 1024);
-    printf("TLB Size:  %d entries\n", tlb_size);
+    printf("\n=== Large-page STLB sharing ===\n");
+    for (int k = 1; k < num_kinds; k++) {
+        if (!available[k]) continue;
+        print_bytes(kinds[k].page_size);
+        double ratio = probe_stlb_sharing(&kinds[0], &infos[0], &kinds[k], &infos[k]);
+        if (ratio < 0)
+            printf(": unknown (needs a second TLB level for both page sizes)\n");
+        else if (ratio > 1.15)
+            printf(": shares the last-level TLB with base pages (mixed chase %.2fx)\n", ratio);
+        else
+            printf(": separate from base-page entries (mixed chase %.2fx)\n", ratio);
+    }
+
+    printf("\n=== ");
+    print_bytes(page_size);
+    printf(" TLB associativity ===\n");
+    for (int i = 0; i < infos[0].num_levels; i++) {
+        struct tlb_assoc assoc;
+        if (probe_tlb_assoc(&kinds[0], &infos[0], i, &assoc) == 0)
+            print_tlb_assoc(&kinds[0], &infos[0], i, &assoc);
+    }
 
     return 0;
 }
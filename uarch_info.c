@@ -0,0 +1,753 @@
+/*
+ * Core Microarchitecture Probes
+ * Measures out-of-order core resources in core clock cycles
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* High-resolution timing */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t get_time(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t get_time(void) {
+    uint64_t val;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+static inline uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline void memory_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("mfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("dmb sy" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/*
+ * Wait for earlier instructions to execute without draining the store
+ * buffer, so a timestamp after it covers issue but not commit.
+ */
+static inline void execution_barrier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("lfence" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("isb" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+static double ticks_per_ns = 1.0;
+static double ticks_per_cycle = 1.0;
+
+/* Convert get_time() ticks to nanoseconds against CLOCK_MONOTONIC */
+static void calibrate_timer(void) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t start = get_time();
+    double elapsed_ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                     (double)(t1.tv_nsec - t0.tv_nsec);
+    } while (elapsed_ns < 20e6);
+    uint64_t end = get_time();
+    ticks_per_ns = (double)(end - start) / elapsed_ns;
+}
+
+#define CLOCK_CHAIN_ITERS 100000
+
+/*
+ * Convert ticks to core cycles by timing a chain of dependent integer
+ * adds, one cycle each. The timer runs at a fixed rate, so this tracks
+ * the clock the core actually ran at. Best of 5 after a warm-up.
+ */
+static void calibrate_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    double best = 0.0;
+    for (int rep = 0; rep < 6; rep++) {
+        uint64_t x = 0;
+        uint64_t start = get_time();
+        for (int i = 0; i < CLOCK_CHAIN_ITERS; i++) {
+#if defined(__aarch64__)
+            __asm__ __volatile__ (".rept 100\n add %0, %0, %0\n .endr" : "+r"(x));
+#else
+            __asm__ __volatile__ (".rept 100\n add %0, %0\n .endr" : "+r"(x));
+#endif
+        }
+        uint64_t end = get_time();
+        double tpc = (double)(end - start) / (100.0 * CLOCK_CHAIN_ITERS);
+        if (rep > 0 && (best == 0.0 || tpc < best)) best = tpc;
+    }
+    ticks_per_cycle = best;
+#else
+    ticks_per_cycle = ticks_per_ns;     /* no cycle chain; report ns as cycles */
+#endif
+}
+
+static inline double ticks_to_cycles(double ticks) {
+    return ticks / ticks_per_cycle;
+}
+
+/* CPUs this process may run on; pin to the first so cycles stay comparable */
+static int pin_to_first_cpu(void) {
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return -1;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &set)) continue;
+        CPU_ZERO(&set);
+        CPU_SET(c, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) return -1;
+        return c;
+    }
+#endif
+    return -1;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Mean of the fastest 90%: drops interrupts, averages coarse timer ticks */
+static double trimmed_mean(double *samples, int n) {
+    qsort(samples, n, sizeof(double), compare_double);
+    int keep = n - n / 10;
+    double sum = 0.0;
+    for (int i = 0; i < keep; i++) sum += samples[i];
+    return sum / keep;
+}
+
+/* Sattolo's shuffle: one random cycle through every element */
+static void create_pointer_chase(size_t *array, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        array[i] = i;
+
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % i;
+        size_t temp = array[i];
+        array[i] = array[j];
+        array[j] = temp;
+    }
+}
+
+/* 2MB-aligned anonymous buffer, THP requested to keep page walks out */
+static void *alloc_buffer(size_t bytes) {
+    void *p = NULL;
+    if (posix_memalign(&p, 2 * 1024 * 1024, bytes) != 0) return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    memset(p, 0, bytes);
+    return p;
+}
+
+/* Largest cache the OS reports, for sizing DRAM working sets */
+static size_t last_level_cache_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 32 * 1024 * 1024;
+}
+
+static size_t physical_memory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (size_t)pages * page_size;
+    return (size_t)4 * 1024 * 1024 * 1024;
+}
+
+/* Buffer whose random lines miss the LLC: 4x L3, at least 64MB, at most 1/8 of RAM */
+static size_t dram_buffer_bytes(void) {
+    size_t bytes = 4 * last_level_cache_size();
+    if (bytes < 64 * 1024 * 1024) bytes = 64 * 1024 * 1024;
+    if (bytes > physical_memory() / 8) bytes = physical_memory() / 8;
+    return bytes / (2 * 1024 * 1024) * (2 * 1024 * 1024);
+}
+
+#define SB_LINE 64
+#define SB_MAX_STORES 192
+#define SB_STEP 2
+#define SB_BURSTS 200
+
+/*
+ * Store-buffer capacity. Each burst of N stores goes to random lines that
+ * miss every cache, so none can commit before its RFO returns from DRAM.
+ * The store buffer is drained before the burst and the end timestamp
+ * waits only for the stores to execute. Until N exceeds the buffer the
+ * burst issues at a steady per-store cost; the first store past it must
+ * wait for a DRAM round trip. The capacity is the last N that stays
+ * within half a miss latency of the line fitted to the smallest bursts.
+ */
+struct store_buffer {
+    int num_points;
+    int stores[SB_MAX_STORES / SB_STEP];
+    double cycles[SB_MAX_STORES / SB_STEP];
+    double miss_cycles;             /* dependent load miss to the same buffer */
+    int entries;                    /* 0 if no step was found */
+};
+
+/* Average cycles per dependent load over the first `count` lines of `order` */
+static double time_line_misses(char *buf, const uint32_t *order, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        *(char **)(buf + (size_t)order[i] * SB_LINE) =
+            buf + (size_t)order[(i + 1) % count] * SB_LINE;
+
+    char *p = buf + (size_t)order[0] * SB_LINE;
+    memory_barrier();
+    uint64_t start = get_time();
+    for (size_t i = 0; i < count; i++) p = *(char **)p;
+    memory_barrier();
+    uint64_t end = get_time();
+    char *volatile sink = p; (void)sink;
+    return ticks_to_cycles((double)(end - start)) / count;
+}
+
+int probe_store_buffer(struct store_buffer *sb) {
+    memset(sb, 0, sizeof(*sb));
+    size_t bytes = dram_buffer_bytes();
+    size_t num_lines = bytes / SB_LINE;
+    char *buf = (char *)alloc_buffer(bytes);
+    uint32_t *order = (uint32_t *)malloc(num_lines * sizeof(uint32_t));
+    if (!buf || !order) {
+        free(buf);
+        free(order);
+        return -1;
+    }
+    for (size_t i = 0; i < num_lines; i++) order[i] = (uint32_t)i;
+    for (size_t i = num_lines - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    /* Half the buffer, so the chain itself can't settle into the LLC */
+    sb->miss_cycles = time_line_misses(buf, order, num_lines / 2);
+
+    double samples[SB_BURSTS];
+    size_t pos = num_lines / 2;
+    for (int n = SB_STEP; n <= SB_MAX_STORES; n += SB_STEP) {
+        for (int b = 0; b < SB_BURSTS; b++) {
+            if (pos + n > num_lines) pos = 0;
+            const uint32_t *lines = order + pos;
+            pos += n;
+
+            memory_barrier();
+            execution_barrier();
+            uint64_t start = get_time();
+            for (int i = 0; i < n; i++)
+                *(volatile uint64_t *)(buf + (size_t)lines[i] * SB_LINE) = (uint64_t)i;
+            execution_barrier();
+            uint64_t end = get_time();
+            memory_barrier();
+            samples[b] = ticks_to_cycles((double)(end - start));
+        }
+        sb->stores[sb->num_points] = n;
+        sb->cycles[sb->num_points] = trimmed_mean(samples, SB_BURSTS);
+        sb->num_points++;
+    }
+    free(buf);
+    free(order);
+
+    /* Per-store cost from the first four points, well inside any buffer */
+    double slope = (sb->cycles[3] - sb->cycles[0]) / (sb->stores[3] - sb->stores[0]);
+    int above = 0;
+    for (int i = 0; i < sb->num_points; i++) {
+        double fit = sb->cycles[0] + slope * (sb->stores[i] - sb->stores[0]);
+        /* Two points in a row, so one interrupted sample is not a step */
+        above = sb->cycles[i] > fit + 0.5 * sb->miss_cycles ? above + 1 : 0;
+        if (above == 2) {
+            sb->entries = i > 1 ? sb->stores[i - 2] : 0;
+            break;
+        }
+    }
+    return 0;
+}
+
+typedef uint64_t unaligned_u64 __attribute__((aligned(1)));
+
+enum forward_case {
+    FWD_L1_LOAD,        /* reference: plain L1 load chain, nothing to forward */
+    FWD_SAME,           /* 8-byte store, 8-byte load, same address */
+    FWD_NARROW_LOW,     /* 8-byte store, 4-byte load of its low half */
+    FWD_NARROW_HIGH,    /* 8-byte store, 4-byte load of its high half */
+    FWD_WIDE,           /* 4-byte store, 8-byte load covering it */
+    FWD_TWO_STORES,     /* two 4-byte stores, one 8-byte load of both */
+    FWD_PARTIAL,        /* 8-byte store, 8-byte load overlapping half */
+    FWD_MISALIGNED,     /* 8-byte store and load at offset 1 */
+    FWD_LINE_SPLIT,     /* 8-byte store and load across a line boundary */
+    NUM_FORWARD_CASES
+};
+
+static const char *forward_names[NUM_FORWARD_CASES] = {
+    "L1 load (no store)", "same size", "narrow load, low", "narrow load, high",
+    "wider load", "two stores, one load", "partial overlap", "misaligned",
+    "line split",
+};
+
+#define FWD_ITERS (1 << 16)
+
+/*
+ * One store then one load per iteration. The next store's data is the
+ * loaded value, so iterations serialize on the store-to-load path and the
+ * time per iteration is the forwarding (or stall) latency.
+ */
+static uint64_t forward_chain(int c, char *buf, uint64_t v) {
+    char *p = buf + 64;
+    switch (c) {
+    case FWD_L1_LOAD:
+        for (int i = 0; i < FWD_ITERS; i++)
+            v = *(volatile uint64_t *)(p + v);         /* memory is 0 */
+        break;
+    case FWD_SAME:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint64_t *)p = v;
+            v = *(volatile uint64_t *)p;
+        }
+        break;
+    case FWD_NARROW_LOW:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint64_t *)p = v;
+            v = *(volatile uint32_t *)p;
+        }
+        break;
+    case FWD_NARROW_HIGH:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint64_t *)p = v;
+            v = *(volatile uint32_t *)(p + 4);
+        }
+        break;
+    case FWD_WIDE:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint32_t *)p = (uint32_t)v;
+            v = *(volatile uint64_t *)p;
+        }
+        break;
+    case FWD_TWO_STORES:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint32_t *)p = (uint32_t)v;
+            *(volatile uint32_t *)(p + 4) = (uint32_t)v;
+            v = *(volatile uint64_t *)p;
+        }
+        break;
+    case FWD_PARTIAL:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile uint64_t *)p = v;
+            v = *(volatile unaligned_u64 *)(p + 4);
+        }
+        break;
+    case FWD_MISALIGNED:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile unaligned_u64 *)(p + 1) = v;
+            v = *(volatile unaligned_u64 *)(p + 1);
+        }
+        break;
+    default:
+        for (int i = 0; i < FWD_ITERS; i++) {
+            *(volatile unaligned_u64 *)(p + 60) = v;
+            v = *(volatile unaligned_u64 *)(p + 60);
+        }
+        break;
+    }
+    return v;
+}
+
+/* Cycles per store/load round trip for each case, best of 5 */
+int probe_store_forwarding(double *cycles) {
+    char *buf = (char *)aligned_alloc(4096, 4096);
+    if (!buf) return -1;
+    memset(buf, 0, 4096);
+
+    uint64_t v = 0;
+    for (int c = 0; c < NUM_FORWARD_CASES; c++) {
+        cycles[c] = -1.0;
+        for (int rep = 0; rep < 5; rep++) {
+            memset(buf, 0, 4096);
+            memory_barrier();
+            uint64_t start = get_time();
+            v = forward_chain(c, buf, 0);
+            memory_barrier();
+            uint64_t end = get_time();
+            double cyc = ticks_to_cycles((double)(end - start)) / FWD_ITERS;
+            if (cycles[c] < 0 || cyc < cycles[c]) cycles[c] = cyc;
+        }
+    }
+    volatile uint64_t sink = v; (void)sink;
+    free(buf);
+    return 0;
+}
+
+static void run_store_buffer(void) {
+    printf("=== Store buffer capacity (cycles to issue a burst of missing stores) ===\n");
+    struct store_buffer sb;
+    if (probe_store_buffer(&sb) != 0) {
+        printf("Buffer allocation failed\n");
+        return;
+    }
+    for (int i = 0; i < sb.num_points; i++)
+        printf("%4d stores: %8.1f cycles\n", sb.stores[i], sb.cycles[i]);
+    printf("Load miss to the same buffer: %.0f cycles\n", sb.miss_cycles);
+    if (sb.entries)
+        printf("Store buffer: ~%d entries (bursts beyond stall for a miss)\n", sb.entries);
+    else
+        printf("Store buffer: no step found up to %d stores\n", SB_MAX_STORES);
+
+    printf("\n=== Store-to-load forwarding (cycles per store+load) ===\n");
+    double cycles[NUM_FORWARD_CASES];
+    if (probe_store_forwarding(cycles) != 0) return;
+    for (int c = 0; c < NUM_FORWARD_CASES; c++) {
+        printf("%-22s %6.1f", forward_names[c], cycles[c]);
+        /* A failed forward waits for the store to commit: well above an L1 hit */
+        if (c == FWD_L1_LOAD)
+            printf("\n");
+        else if (cycles[c] > 2.0 * cycles[FWD_L1_LOAD])
+            printf("  stalls\n");
+        else if (cycles[c] < 0.5 * cycles[FWD_L1_LOAD])
+            printf("  forwards (renamed, faster than L1)\n");
+        else
+            printf("  forwards\n");
+    }
+}
+
+#define ROB_LINE 64
+#define ROB_ITERS 2048
+
+enum filler_kind { FILL_NOP, FILL_LOAD, FILL_STORE, NUM_FILLERS };
+static const char *filler_names[NUM_FILLERS] = { "nop", "load", "store" };
+static const char *filler_resources[NUM_FILLERS] = { "ROB", "load queue", "store queue" };
+
+/* Filler counts between the two misses; each needs its own unrolled body */
+#define ROB_COUNTS(X) \
+    X(0) X(16) X(32) X(48) X(64) X(80) X(96) X(112) X(128) X(144) X(160) \
+    X(176) X(192) X(208) X(224) X(240) X(256) X(288) X(320) X(352) X(384) \
+    X(416) X(448) X(480) X(512) X(544) X(576) X(608) X(640) X(704) X(768)
+#define ROB_COUNT_ENTRY(n) n,
+static const int rob_counts[] = { ROB_COUNTS(ROB_COUNT_ENTRY) };
+#define NUM_ROB_COUNTS ((int)(sizeof(rob_counts) / sizeof(rob_counts[0])))
+
+#if defined(__x86_64__)
+#define HAVE_ROB_PROBE 1
+#define ROB_CHASE(r) "mov (%[" #r "]), %[" #r "]\n"
+#define FILLER_NOP   "nop\n"
+#define FILLER_LOAD  "mov (%[s]), %[t]\n"
+#define FILLER_STORE "mov %[t], (%[s])\n"
+#elif defined(__aarch64__)
+#define HAVE_ROB_PROBE 1
+#define ROB_CHASE(r) "ldr %[" #r "], [%[" #r "]]\n"
+#define FILLER_NOP   "nop\n"
+#define FILLER_LOAD  "ldr %[t], [%[s]]\n"
+#define FILLER_STORE "str %[t], [%[s]]\n"
+#else
+#define HAVE_ROB_PROBE 0
+#endif
+
+#if HAVE_ROB_PROBE
+/* Miss on chain p, n fillers, miss on chain q, n fillers */
+#define ROB_BODY(n, filler) \
+    __asm__ __volatile__ ( \
+        ROB_CHASE(p) ".rept " #n "\n" filler ".endr\n" \
+        ROB_CHASE(q) ".rept " #n "\n" filler ".endr\n" \
+        : [p] "+r"(p), [q] "+r"(q), [t] "+r"(t) : [s] "r"(scratch) : "memory")
+
+#define ROB_CASE(n) \
+    case n: \
+        for (int i = 0; i < ROB_ITERS; i++) { \
+            if (kind == FILL_NOP) ROB_BODY(n, FILLER_NOP); \
+            else if (kind == FILL_LOAD) ROB_BODY(n, FILLER_LOAD); \
+            else ROB_BODY(n, FILLER_STORE); \
+        } \
+        break;
+
+/* Cycles per iteration (two misses) with `n` fillers of `kind` after each */
+static double time_rob_fillers(void **chains[2], int kind, int n) {
+    static uint64_t scratch[8];
+    void **p = chains[0], **q = chains[1];
+    uint64_t t = 0;
+
+    memory_barrier();
+    uint64_t start = get_time();
+    switch (n) {
+    ROB_COUNTS(ROB_CASE)
+    default: break;
+    }
+    memory_barrier();
+    uint64_t end = get_time();
+
+    chains[0] = p;
+    chains[1] = q;
+    return ticks_to_cycles((double)(end - start)) / ROB_ITERS;
+}
+#endif
+
+/*
+ * Out-of-order window. Two independent pointer chases through a buffer
+ * far larger than the LLC miss on every step. With few fillers between
+ * them both misses are in flight together and an iteration costs about
+ * one miss; once the fillers no longer fit the structure they occupy,
+ * the second miss cannot issue until the first retires and the cost
+ * approaches two misses. nop fills the ROB, independent L1 loads the
+ * load queue, and stores the store queue.
+ */
+struct ooo_window {
+    double cycles[NUM_FILLERS][NUM_ROB_COUNTS];
+    int entries[NUM_FILLERS];       /* 0 if the window held every count */
+};
+
+int probe_ooo_window(struct ooo_window *ow) {
+    memset(ow, 0, sizeof(*ow));
+#if HAVE_ROB_PROBE
+    size_t bytes = dram_buffer_bytes();
+    size_t count = bytes / ROB_LINE;
+    size_t *next = (size_t *)malloc(count * sizeof(size_t));
+    char *bufs[2] = { (char *)alloc_buffer(bytes), (char *)alloc_buffer(bytes) };
+    if (!next || !bufs[0] || !bufs[1]) {
+        free(next);
+        free(bufs[0]);
+        free(bufs[1]);
+        return -1;
+    }
+
+    /* One line per element so every step is a fresh miss */
+    void **chains[2];
+    for (int c = 0; c < 2; c++) {
+        create_pointer_chase(next, count);
+        for (size_t i = 0; i < count; i++)
+            *(void **)(bufs[c] + i * ROB_LINE) = bufs[c] + next[i] * ROB_LINE;
+        chains[c] = (void **)bufs[c];
+    }
+    free(next);
+
+    for (int k = 0; k < NUM_FILLERS; k++) {
+        for (int i = 0; i < NUM_ROB_COUNTS; i++) {
+            double best = -1.0;
+            for (int rep = 0; rep < 3; rep++) {
+                double cyc = time_rob_fillers(chains, k, rob_counts[i]);
+                if (best < 0 || cyc < best) best = cyc;
+            }
+            ow->cycles[k][i] = best;
+        }
+
+        /* Step: 1.5x the overlapped cost, on two counts in a row */
+        int above = 0;
+        for (int i = 1; i < NUM_ROB_COUNTS; i++) {
+            above = ow->cycles[k][i] > 1.5 * ow->cycles[k][0] ? above + 1 : 0;
+            if (above == 2) {
+                ow->entries[k] = rob_counts[i - 2];
+                break;
+            }
+        }
+    }
+    free(bufs[0]);
+    free(bufs[1]);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+static void run_ooo_window(void) {
+    printf("=== Out-of-order window (cycles per pair of misses) ===\n");
+    struct ooo_window ow;
+    if (probe_ooo_window(&ow) != 0) {
+        printf("Not supported on this architecture or allocation failed\n");
+        return;
+    }
+    printf("%8s", "fillers");
+    for (int k = 0; k < NUM_FILLERS; k++) printf(" %9s", filler_names[k]);
+    printf("\n");
+    for (int i = 0; i < NUM_ROB_COUNTS; i++) {
+        printf("%8d", rob_counts[i]);
+        for (int k = 0; k < NUM_FILLERS; k++) printf(" %9.0f", ow.cycles[k][i]);
+        printf("\n");
+    }
+    printf("\n");
+    for (int k = 0; k < NUM_FILLERS; k++) {
+        if (ow.entries[k])
+            printf("%-12s ~%d entries (misses stop overlapping past %d %ss)\n",
+                   filler_resources[k], ow.entries[k], ow.entries[k], filler_names[k]);
+        else
+            printf("%-12s no step up to %d %ss\n", filler_resources[k],
+                   rob_counts[NUM_ROB_COUNTS - 1], filler_names[k]);
+    }
+}
+
+#define L1_ITERS 20000
+#define L1_REPS 5
+#define BANK_OFFSETS 16             /* 4-byte steps across one line */
+#define ALIAS_PAGES 8
+
+/* Unrolled so the loop branch stays out of the measured rate */
+#define REPEAT4(x) x x x x
+#define REPEAT16(x) REPEAT4(REPEAT4(x))
+
+/* Cycles per pair of independent 4-byte loads from a and b, best of L1_REPS */
+static double time_load_pairs(const char *a, const char *b) {
+    double best = -1.0;
+    for (int rep = 0; rep < L1_REPS; rep++) {
+        memory_barrier();
+        uint64_t start = get_time();
+        for (int i = 0; i < L1_ITERS; i++) {
+            REPEAT16((void)*(volatile const uint32_t *)a;
+                     (void)*(volatile const uint32_t *)b;)
+        }
+        memory_barrier();
+        uint64_t end = get_time();
+        double cyc = ticks_to_cycles((double)(end - start)) / (16.0 * L1_ITERS);
+        if (best < 0 || cyc < best) best = cyc;
+    }
+    return best;
+}
+
+/*
+ * Cycles per store followed by an unrelated load `distance` bytes away.
+ * Eight pairs per iteration, each on its own 8-byte slot, so only the
+ * address comparison between them can slow the loads down.
+ */
+static double time_store_load_pairs(char *s, size_t distance) {
+    double best = -1.0;
+    for (int rep = 0; rep < L1_REPS; rep++) {
+        memory_barrier();
+        uint64_t start = get_time();
+#define STORE_LOAD(k) \
+            *(volatile uint32_t *)(s + 8 * k) = (uint32_t)i; \
+            (void)*(volatile const uint32_t *)(s + 8 * k + distance);
+        for (int i = 0; i < L1_ITERS; i++) {
+            STORE_LOAD(0) STORE_LOAD(1) STORE_LOAD(2) STORE_LOAD(3)
+            STORE_LOAD(4) STORE_LOAD(5) STORE_LOAD(6) STORE_LOAD(7)
+        }
+#undef STORE_LOAD
+        memory_barrier();
+        uint64_t end = get_time();
+        double cyc = ticks_to_cycles((double)(end - start)) / (8.0 * L1_ITERS);
+        if (best < 0 || cyc < best) best = cyc;
+    }
+    return best;
+}
+
+/*
+ * L1 bank conflicts and 4K aliasing. Bank conflicts: two loads per
+ * iteration to different lines, the second at each 4-byte offset of its
+ * line; cores with banked L1s lose dual-load throughput when both hit
+ * the same bank. 4K aliasing: a load whose address matches an in-flight
+ * store in bits 0-11 is held as if it depended on it; compared with the
+ * same distance plus one line, which shares no low bits.
+ */
+struct l1_conflicts {
+    double pair_cycles[BANK_OFFSETS];   /* per pair of loads, by offset of the second */
+    double alias_cycles[ALIAS_PAGES];   /* store + load k * 4KB away */
+    double control_cycles[ALIAS_PAGES]; /* store + load k * 4KB + 64 away */
+};
+
+int probe_l1_conflicts(struct l1_conflicts *lc) {
+    char *buf = (char *)aligned_alloc(4096, (ALIAS_PAGES + 2) * 4096);
+    if (!buf) return -1;
+    memset(buf, 0, (ALIAS_PAGES + 2) * 4096);
+
+    /* Lines 9 apart land in different sets, so only the bank can clash */
+    for (int o = 0; o < BANK_OFFSETS; o++)
+        lc->pair_cycles[o] = time_load_pairs(buf, buf + 9 * 64 + 4 * o);
+
+    for (int k = 0; k < ALIAS_PAGES; k++) {
+        size_t distance = (size_t)(k + 1) * 4096;
+        lc->alias_cycles[k] = time_store_load_pairs(buf, distance);
+        lc->control_cycles[k] = time_store_load_pairs(buf, distance + 64);
+    }
+    free(buf);
+    return 0;
+}
+
+static void run_l1_conflicts(void) {
+    struct l1_conflicts lc;
+    if (probe_l1_conflicts(&lc) != 0) {
+        printf("Buffer allocation failed\n");
+        return;
+    }
+
+    printf("=== L1 bank conflicts (cycles per pair of loads to different lines) ===\n");
+    double best = lc.pair_cycles[0];
+    for (int o = 1; o < BANK_OFFSETS; o++)
+        if (lc.pair_cycles[o] < best) best = lc.pair_cycles[o];
+    int conflicts = 0;
+    for (int o = 0; o < BANK_OFFSETS; o++) {
+        int slow = lc.pair_cycles[o] > 1.2 * best;
+        conflicts += slow;
+        printf("offset %2d: %5.2f cycles (%.2f loads/cycle)%s\n", 4 * o, lc.pair_cycles[o],
+               2.0 / lc.pair_cycles[o], slow ? "  conflict" : "");
+    }
+    if (conflicts)
+        printf("Avoid the offsets marked conflict between lines read together\n");
+    else
+        printf("No bank conflicts: dual loads run at full rate at every offset\n");
+
+    printf("\n=== 4K aliasing (cycles per store + unrelated load) ===\n");
+    printf("%9s %9s %9s %8s\n", "distance", "aliased", "+64 B", "penalty");
+    double worst = 0.0;
+    for (int k = 0; k < ALIAS_PAGES; k++) {
+        double penalty = lc.alias_cycles[k] - lc.control_cycles[k];
+        if (penalty > worst) worst = penalty;
+        printf("%6d KB %9.2f %9.2f %8.2f\n", 4 * (k + 1), lc.alias_cycles[k],
+               lc.control_cycles[k], penalty);
+    }
+    if (worst > 0.5)
+        printf("Buffers written and read together should not sit a multiple of 4 KB\n"
+               "apart; offset one by at least a line (%.1f cycles per aliased pair).\n", worst);
+    else
+        printf("No 4K-aliasing penalty measured\n");
+}
+
+int main(int argc, char **argv) {
+    int cpu = pin_to_first_cpu();
+    calibrate_timer();
+    calibrate_cycles();
+    printf("Pinned to CPU %d, core clock ~%.2f GHz (%.3f timer ticks per cycle)\n\n",
+           cpu, ticks_per_ns / ticks_per_cycle, ticks_per_cycle);
+
+    const char *mode = argc > 1 ? argv[1] : "all";
+    int all = strcmp(mode, "all") == 0;
+    int matched = 0;
+    if (all || strcmp(mode, "storebuf") == 0) {
+        run_store_buffer();
+        matched = 1;
+    }
+    if (all || strcmp(mode, "rob") == 0) {
+        if (all) printf("\n");
+        run_ooo_window();
+        matched = 1;
+    }
+    if (all || strcmp(mode, "l1") == 0) {
+        if (all) printf("\n");
+        run_l1_conflicts();
+        matched = 1;
+    }
+    if (!matched) {
+        printf("Usage: %s [all | storebuf | rob | l1]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}